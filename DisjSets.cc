@@ -11,27 +11,45 @@ using std::unordered_map;
  */
 DisjSets::DisjSets( int numElements ) : s( numElements )
 {
-    for( int i = 0; i < s.size( ); i++ )
-        s[ i ] = -1;
+    for( int i = 0; i < numElements; i++ )
+        s[ i ] = i;
+}
+
+/**
+ * Add a new set holding only a new element.
+ * Return the new element.
+ */
+int DisjSets::makeSet( )
+{
+    s.push_back( static_cast<uint32_t>( s.size( ) ) );
+    return static_cast<int>( s.size( ) - 1 );
 }
 
 /**
  * Union two disjoint sets.
- * For simplicity, we assume root1 and root2 are distinct
- * and represent set names.
+ * root1 and root2 have to represent set names; they may be the same set.
+ * The smaller root becomes the root of the merged set.
  * root1 is the root of set 1.
  * root2 is the root of set 2.
  */
 void DisjSets::unionSets( int root1, int root2 )
 {
-    if( s[ root2 ] < s[ root1 ] )  // root2 is deeper
-        s[ root1 ] = root2;        // Make root2 new root
+    if( root1 < root2 )
+        s[ root2 ] = root1;
     else
-    {
-        if( s[ root1 ] == s[ root2 ] )
-            s[ root1 ]--;          // Update height if same
-        s[ root2 ] = root1;        // Make root1 new root
-    }
+        s[ root1 ] = root2;
+}
+
+/**
+ * Union the sets containing x and y.
+ * Return the root of the merged set.
+ */
+int DisjSets::unite( int x, int y )
+{
+    int root1 = find( x );
+    int root2 = find( y );
+    unionSets( root1, root2 );
+    return root1 < root2 ? root1 : root2;
 }
 
 
@@ -42,23 +60,50 @@ void DisjSets::unionSets( int root1, int root2 )
  */
 int DisjSets::find( int x ) const
 {
-    if( s[ x ] < 0 )
-        return x;
-    else
-        return find( s[ x ] );
+    uint32_t e = x;
+    while( s[ e ] != e )
+        e = s[ e ];
+    return static_cast<int>( e );
 }
 
 
 /**
- * Perform a find with path compression.
+ * Perform a find with path halving: every visited element
+ * is linked to its grandparent.
  * Error checks omitted again for simplicity.
  * Return the set containing x.
  */
 int DisjSets::find( int x )
 {
-    if( s[ x ] < 0 )
-        return x;
-    else
-        return s[ x ] = find( s[ x ] );
+    uint32_t e = x;
+    while( s[ e ] != e )
+    {
+        s[ e ] = s[ s[ e ] ];
+        e = s[ e ];
+    }
+    return static_cast<int>( e );
 }
 
+
+/**
+ * Replace the forest by consecutive set numbers 0..count-1, in
+ * the order of the smallest element of each set, and return count.
+ * Labeling algorithms that keep element 0 for the background
+ * get it numbered 0 and their components numbered from 1.
+ * Afterwards label( x ) gives the number of the set of x;
+ * find and union must not be used anymore.
+ * One pass is enough because parents are never larger than
+ * their children.
+ */
+int DisjSets::flatten( )
+{
+    uint32_t count = 0;
+    for( size_t i = 0; i < s.size( ); i++ )
+    {
+        if( s[ i ] == i )
+            s[ i ] = count++;
+        else
+            s[ i ] = s[ s[ i ] ];
+    }
+    return static_cast<int>( count );
+}
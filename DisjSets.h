@@ -7,10 +7,15 @@
 //
 // ******************PUBLIC OPERATIONS*********************
 // void union( root1, root2 ) --> Merge two sets
+// int unite( x, y )          --> Merge the sets of x and y, return root
 // int find( x )              --> Return set containing x
+// int makeSet( )             --> Add a new set, return its element
+// int flatten( )             --> Number the sets 0..count-1
+// int label( x )             --> Number of the set of x after flatten
 // ******************ERRORS********************************
 // No error checking is performed
 
+#include <cstdint>
 #include <vector>
 #include <unordered_map>
 using std::unordered_map;
@@ -19,20 +24,32 @@ using namespace std;
 
 /**
  * Disjoint set class.
- * Use union by rank and path compression.
+ * Use union by index and path halving; both loops are iterative,
+ * so long chains cannot overflow the stack.
+ * The smaller root always becomes the parent, so every element's
+ * parent is never larger than the element itself, and the root of
+ * a set is its smallest element. Labeling algorithms that create
+ * elements in raster order get the first pixel of each component
+ * as its root.
  * Elements in the set are numbered starting at 0.
  */
 class DisjSets
 {
   public:
-    explicit DisjSets( int numElements );
+    explicit DisjSets( int numElements = 0 );
 
     int find( int x ) const;
     int find( int x );
     void unionSets( int root1, int root2 );
+    int unite( int x, int y );
+    int makeSet( );
+    int size( ) const { return static_cast<int>( s.size( ) ); }
+
+    int flatten( );
+    int label( int x ) const { return static_cast<int>( s[ x ] ); }
 
   private:
-    vector<int> s;
+    vector<uint32_t> s;
 };
 
 #endif
@@ -0,0 +1,43 @@
+//
+// convert_database.cpp
+// Converts a text object database written by p3 into the binary
+// format, which p4 memory-maps instead of parsing, or merges the
+// segments p3 appended to a database into it.
+//
+
+#include "object_database.h"
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+
+using namespace std;
+using namespace ComputerVisionProjects;
+
+int
+main(int argc, char **argv){
+
+    if (argc!=3) {
+        printf("Usage: %s text_database binary_database\n", argv[0]);
+        printf("       %s -compact database\n", argv[0]);
+        return 0;
+    }
+
+    if (string(argv[1]) == "-compact") {
+        const string database(argv[2]);
+        const int merged = CompactObjectDatabase(database);
+        if (merged < 0) {
+            cout << "Can't compact " << database << endl;
+            return 1;
+        }
+        cout << "Merged " << merged << " segments into " << database << endl;
+        return 0;
+    }
+
+    const string text_file(argv[1]);
+    const string binary_file(argv[2]);
+    if (!ConvertObjectDatabase(text_file, binary_file)) {
+        cout << "Can't convert " << text_file << endl;
+        return 1;
+    }
+}
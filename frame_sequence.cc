@@ -0,0 +1,253 @@
+//
+// frame_sequence.cc
+// Incremental labeling of a sequence of frames.
+//
+
+#include "frame_sequence.h"
+#include "DisjSets.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+using namespace std;
+
+namespace ComputerVisionProjects {
+
+    FrameSequenceLabeler::FrameSequenceLabeler(int treshold, size_t tile_size)
+            : treshold_{treshold}, tile_size_{max<size_t>(tile_size, 1)}, tile_rows_{0}, tile_columns_{0},
+              num_objects_{0} { }
+
+    size_t FrameSequenceLabeler::AddFrame(const Image &frame) {
+        const size_t num_rows = frame.num_rows();
+        const size_t num_columns = frame.num_columns();
+        if (in_region_.empty() || num_rows != previous_.num_rows() || num_columns != previous_.num_columns() ||
+            frame.pixel_type() != previous_.pixel_type()) {
+            //nothing to reuse: every tile is labeled
+            previous_ = Image(frame);
+            binary_.AllocateSpaceAndSetSize(num_rows, num_columns, PixelType::kUInt8);
+            labels_.AllocateSpaceAndSetSize(num_rows, num_columns, PixelType::kInt32);
+            for (size_t i = 0; i < num_rows; ++i) memset(labels_.RowBytes(i), 0, num_columns * sizeof(int32_t));
+            moments_.Reset(0);
+            num_objects_ = 0;
+            free_labels_.clear();
+            tile_rows_ = (num_rows + tile_size_ - 1) / tile_size_;
+            tile_columns_ = (num_columns + tile_size_ - 1) / tile_size_;
+            in_region_.assign(tile_rows_ * tile_columns_, 1);
+            ThresholdTiles(frame);
+        } else {
+            in_region_.assign(tile_rows_ * tile_columns_, 0);
+            FindChangedTiles(frame);
+        }
+        if (find(in_region_.begin(), in_region_.end(), 1) == in_region_.end()) return 0;
+
+        GrowRegion();
+        LabelRegion();
+        return count(in_region_.begin(), in_region_.end(), 1);
+    }
+
+    void FrameSequenceLabeler::FindChangedTiles(const Image &frame) {
+        const size_t bytes_per_pixel = frame.bytes_per_pixel();
+        const size_t num_rows = frame.num_rows();
+        const size_t num_columns = frame.num_columns();
+        for (size_t tile_row = 0; tile_row < tile_rows_; ++tile_row) {
+            const size_t first_row = tile_row * tile_size_;
+            const size_t end_row = min(first_row + tile_size_, num_rows);
+            char *changed = &in_region_[tile_row * tile_columns_];
+            //a tile is compared until its first differing row
+            for (size_t i = first_row; i < end_row; ++i) {
+                const unsigned char *row = frame.RowBytes(i);
+                const unsigned char *old_row = previous_.RowBytes(i);
+                for (size_t tile = 0; tile < tile_columns_; ++tile) {
+                    if (changed[tile]) continue;
+                    const size_t first = tile * tile_size_;
+                    const size_t width = min(first + tile_size_, num_columns) - first;
+                    if (memcmp(row + first * bytes_per_pixel, old_row + first * bytes_per_pixel,
+                               width * bytes_per_pixel) != 0) changed[tile] = 1;
+                }
+            }
+            for (size_t i = first_row; i < end_row; ++i) {
+                for (size_t tile = 0; tile < tile_columns_; ++tile) {
+                    if (!changed[tile]) continue;
+                    const size_t first = tile * tile_size_;
+                    const size_t width = min(first + tile_size_, num_columns) - first;
+                    memcpy(previous_.RowBytes(i) + first * bytes_per_pixel,
+                           frame.RowBytes(i) + first * bytes_per_pixel, width * bytes_per_pixel);
+                }
+            }
+        }
+        ThresholdTiles(frame);
+    }
+
+    void FrameSequenceLabeler::ThresholdTiles(const Image &frame) {
+        const size_t num_columns = frame.num_columns();
+        DispatchPixelType(frame.pixel_type(), [&](auto pixel) {
+            using T = decltype(pixel);
+            for (size_t i = 0; i < frame.num_rows(); ++i) {
+                const T *row = frame.Row<T>(i);
+                uint8_t *binary = binary_.Row<uint8_t>(i);
+                const char *region = &in_region_[i / tile_size_ * tile_columns_];
+                for (size_t tile = 0; tile < tile_columns_; ++tile) {
+                    if (!region[tile]) continue;
+                    const size_t end = min((tile + 1) * tile_size_, num_columns);
+                    for (size_t j = tile * tile_size_; j < end; ++j) binary[j] = row[j] >= treshold_ ? 1 : 0;
+                }
+            }
+        });
+    }
+
+    void FrameSequenceLabeler::AddTiles(int64_t min_i, int64_t max_i, int64_t min_j, int64_t max_j,
+                                        vector<size_t> *pending) {
+        for (size_t tile_row = min_i / tile_size_; tile_row <= size_t(max_i) / tile_size_; ++tile_row) {
+            for (size_t tile = min_j / tile_size_; tile <= size_t(max_j) / tile_size_; ++tile) {
+                const size_t index = tile_row * tile_columns_ + tile;
+                if (in_region_[index]) continue;
+                in_region_[index] = 1;
+                pending->push_back(index);
+            }
+        }
+    }
+
+    void FrameSequenceLabeler::AffectLabel(int32_t label, vector<size_t> *pending) {
+        affected_[label] = 1;
+        AddTiles(moments_.min_i[label], moments_.max_i[label], moments_.min_j[label], moments_.max_j[label],
+                 pending);
+    }
+
+    void FrameSequenceLabeler::GrowRegion() {
+        const size_t num_rows = labels_.num_rows();
+        const size_t num_columns = labels_.num_columns();
+        affected_.assign(moments_.area.size(), 0);
+        vector<size_t> pending;
+        for (size_t index = 0; index < in_region_.size(); ++index)
+            if (in_region_[index]) pending.push_back(index);
+
+        //checks the neighbors of a foreground pixel of the region that
+        //lie outside it; their objects would join the new ones
+        auto check_outside = [&](size_t i, size_t j) {
+            if (!binary_.Row<uint8_t>(i)[j]) return;
+            for (size_t y = i > 0 ? i - 1 : 0; y <= min(i + 1, num_rows - 1); ++y) {
+                const int32_t *row = labels_.Row<int32_t>(y);
+                for (size_t x = j > 0 ? j - 1 : 0; x <= min(j + 1, num_columns - 1); ++x) {
+                    if (in_region_[y / tile_size_ * tile_columns_ + x / tile_size_]) continue;
+                    if (row[x] > 0 && !affected_[row[x]]) AffectLabel(row[x], &pending);
+                }
+            }
+        };
+
+        while (!pending.empty()) {
+            //every object with a pixel in the region is labeled again,
+            //so all of its tiles join the region
+            while (!pending.empty()) {
+                const size_t index = pending.back();
+                pending.pop_back();
+                const size_t first_row = index / tile_columns_ * tile_size_;
+                const size_t first = index % tile_columns_ * tile_size_;
+                const size_t end_row = min(first_row + tile_size_, num_rows);
+                const size_t end = min(first + tile_size_, num_columns);
+                for (size_t i = first_row; i < end_row; ++i) {
+                    const int32_t *row = labels_.Row<int32_t>(i);
+                    for (size_t j = first; j < end; ++j)
+                        if (row[j] > 0 && !affected_[row[j]]) AffectLabel(row[j], &pending);
+                }
+            }
+            //and so is every object next to the new foreground along
+            //the border of the region
+            for (size_t index = 0; index < in_region_.size(); ++index) {
+                if (!in_region_[index]) continue;
+                const size_t first_row = index / tile_columns_ * tile_size_;
+                const size_t first = index % tile_columns_ * tile_size_;
+                const size_t last_row = min(first_row + tile_size_, num_rows) - 1;
+                const size_t last = min(first + tile_size_, num_columns) - 1;
+                for (size_t j = first; j <= last; ++j) {
+                    check_outside(first_row, j);
+                    check_outside(last_row, j);
+                }
+                for (size_t i = first_row + 1; i < last_row; ++i) {
+                    check_outside(i, first);
+                    check_outside(i, last);
+                }
+            }
+        }
+    }
+
+    int32_t FrameSequenceLabeler::NewLabel() {
+        if (!free_labels_.empty()) {
+            const int32_t label = free_labels_.back();
+            free_labels_.pop_back();
+            return label;
+        }
+        moments_.Resize(moments_.num_labels() + 1);
+        return moments_.num_labels();
+    }
+
+    void FrameSequenceLabeler::LabelRegion() {
+        const size_t num_rows = labels_.num_rows();
+        const size_t num_columns = labels_.num_columns();
+        for (int label = 1; label < int(affected_.size()); ++label) {
+            if (!affected_[label]) continue;
+            moments_.Clear(label);
+            free_labels_.push_back(label);
+            --num_objects_;
+        }
+        //the smallest free labels are given first
+        sort(free_labels_.begin(), free_labels_.end(), greater<int32_t>());
+
+        //provisional labels are negative. Pixels outside the region are
+        //>= 0 and never next to its foreground, so only the region is
+        //looked at
+        DisjSets equivalences;
+        equivalences.makeSet();  //0 is the background
+        for (size_t i = 0; i < num_rows; ++i) {
+            const uint8_t *binary = binary_.Row<uint8_t>(i);
+            int32_t *row = labels_.Row<int32_t>(i);
+            const int32_t *above = i > 0 ? labels_.Row<int32_t>(i - 1) : nullptr;
+            const char *region = &in_region_[i / tile_size_ * tile_columns_];
+            for (size_t tile = 0; tile < tile_columns_; ++tile) {
+                if (!region[tile]) continue;
+                const size_t end = min((tile + 1) * tile_size_, num_columns);
+                for (size_t j = tile * tile_size_; j < end; ++j) {
+                    if (!binary[j]) {
+                        row[j] = 0;
+                        continue;
+                    }
+                    int set = 0;
+                    auto join = [&](int32_t neighbor) {
+                        if (neighbor >= 0) return;
+                        set = set == 0 ? -neighbor : equivalences.unite(set, -neighbor);
+                    };
+                    if (j > 0) join(row[j - 1]);
+                    if (above != nullptr) {
+                        if (j > 0) join(above[j - 1]);
+                        join(above[j]);
+                        if (j + 1 < num_columns) join(above[j + 1]);
+                    }
+                    row[j] = -(set == 0 ? equivalences.makeSet() : set);
+                }
+            }
+        }
+
+        const int num_sets = equivalences.flatten();
+        vector<int32_t> labels(num_sets, 0);
+        for (int k = 1; k < num_sets; ++k) labels[k] = NewLabel();
+        num_objects_ += num_sets - 1;
+        for (size_t i = 0; i < num_rows; ++i) {
+            int32_t *row = labels_.Row<int32_t>(i);
+            const char *region = &in_region_[i / tile_size_ * tile_columns_];
+            for (size_t tile = 0; tile < tile_columns_; ++tile) {
+                if (!region[tile]) continue;
+                const size_t end = min((tile + 1) * tile_size_, num_columns);
+                size_t j = tile * tile_size_;
+                while (j < end) {
+                    if (row[j] == 0) {
+                        ++j;
+                        continue;
+                    }
+                    const int32_t label = labels[equivalences.label(-row[j])];
+                    const size_t first = j;
+                    while (j < end && row[j] < 0 && labels[equivalences.label(-row[j])] == label) row[j++] = label;
+                    moments_.AddRun(label, i, first, j - 1);
+                }
+            }
+        }
+    }
+}  // namespace ComputerVisionProjects
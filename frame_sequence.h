@@ -0,0 +1,95 @@
+// Incremental labeling of a sequence of frames.
+// To be used in Computer Vision class.
+//
+// frame_sequence.h
+// Consecutive frames of a video mostly repeat each other. A
+// FrameSequenceLabeler compares every frame with the previous one
+// tile by tile and thresholds and labels again only the tiles that
+// changed, together with the tiles of every object that touches
+// them. The moments of the other objects are kept from the previous
+// frame, so the labeling work per frame is proportional to the
+// changed area rather than to the size of the frame.
+
+#ifndef COMPUTER_VISION_FRAME_SEQUENCE_H_
+#define COMPUTER_VISION_FRAME_SEQUENCE_H_
+
+#include "image.h"
+#include "moments.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ComputerVisionProjects {
+
+// Labels the frames of a sequence with 8-connectivity; pixels
+// >= treshold are foreground, as in ConvertToBinary().
+// Sample usage:
+//   FrameSequenceLabeler labeler(128);
+//   for (...) {
+//     labeler.AddFrame(frame);
+//     CheckObjectFromDatabase(database, labeler.moments(), &frame);
+//   }
+//
+// An object keeps its label from frame to frame while none of the
+// tiles it lies in changes. Labels of objects that disappear are
+// given to new objects later, so unlike the labeling engines of
+// labeling.h the labels are not in raster order and may skip
+// numbers; the moments of unused labels are empty.
+class FrameSequenceLabeler {
+ public:
+  explicit FrameSequenceLabeler(int treshold, size_t tile_size = 32);
+
+  // Labels the next frame. A frame with a different size or pixel
+  // type than the previous one is labeled from scratch. Returns the
+  // number of tiles that were labeled again, 0 when nothing changed.
+  size_t AddFrame(const Image &frame);
+
+  // Labels of the last frame, PixelType::kInt32, 0 for the background.
+  const Image &label_image() const { return labels_; }
+  // Moments of the objects of the last frame, indexed by label.
+  const MomentSums &moments() const { return moments_; }
+  int num_objects() const { return num_objects_; }
+  size_t num_tiles() const { return in_region_.size(); }
+
+ private:
+  // Marks the tiles of frame that differ from previous_ and copies
+  // them into previous_ and, thresholded, into binary_.
+  void FindChangedTiles(const Image &frame);
+  // Thresholds the tiles of frame marked in in_region_ into binary_.
+  void ThresholdTiles(const Image &frame);
+  // Adds to the region every object with a pixel in it and every
+  // object touching its foreground from outside, with all their tiles.
+  void GrowRegion();
+  // Adds the tiles of rows min_i..max_i and columns min_j..max_j to
+  // the region and to pending.
+  void AddTiles(int64_t min_i, int64_t max_i, int64_t min_j,
+                int64_t max_j, std::vector<size_t> *pending);
+  // Marks label as affected and adds its tiles.
+  void AffectLabel(int32_t label, std::vector<size_t> *pending);
+  // Labels the foreground of the region again and adds the moments
+  // of its objects.
+  void LabelRegion();
+  int32_t NewLabel();
+
+  int treshold_;
+  size_t tile_size_;
+  size_t tile_rows_;
+  size_t tile_columns_;
+  // Last frame, thresholded last frame (0 or 1) and its labels.
+  Image previous_;
+  Image binary_;
+  Image labels_;
+  MomentSums moments_;
+  int num_objects_;
+  // Labels of objects that disappeared, largest first.
+  std::vector<int32_t> free_labels_;
+  // Per tile, row by row: 1 if it is labeled again this frame.
+  std::vector<char> in_region_;
+  // Per label: 1 if its object is labeled again this frame.
+  std::vector<char> affected_;
+};
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_FRAME_SEQUENCE_H_
@@ -0,0 +1,149 @@
+//
+// histogram.cc
+// Histogram engine and histogram-based threshold selection.
+//
+
+#include "histogram.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+namespace ComputerVisionProjects {
+
+    uint64_t Histogram::total() const {
+        uint64_t sum = 0;
+        for (uint64_t count: counts) sum += count;
+        return sum;
+    }
+
+    namespace {
+        const int kNumBanks = 4;
+        //banks are flushed into the 64-bit counts well before they can overflow
+        const uint64_t kFlushInterval = uint64_t(1) << 30;
+
+        //counts one row into the banks, 8 pixels per 64-bit load;
+        //pixel k of a load goes to bank k % kNumBanks
+        void CountRow(const uint8_t *row, size_t num_pixels, uint32_t (*banks)[256]) {
+            size_t j = 0;
+            for (; j + 8 <= num_pixels; j += 8) {
+                uint64_t pixels;
+                memcpy(&pixels, row + j, sizeof pixels);
+                ++banks[0][pixels & 0xff];
+                ++banks[1][(pixels >> 8) & 0xff];
+                ++banks[2][(pixels >> 16) & 0xff];
+                ++banks[3][(pixels >> 24) & 0xff];
+                ++banks[0][(pixels >> 32) & 0xff];
+                ++banks[1][(pixels >> 40) & 0xff];
+                ++banks[2][(pixels >> 48) & 0xff];
+                ++banks[3][pixels >> 56];
+            }
+            for (; j < num_pixels; ++j) ++banks[j % kNumBanks][row[j]];
+        }
+
+        void FlushBanks(uint32_t (*banks)[256], vector<uint64_t> *counts) {
+            for (int bank = 0; bank < kNumBanks; ++bank) {
+                for (int v = 0; v < 256; ++v) (*counts)[v] += banks[bank][v];
+            }
+            memset(banks, 0, sizeof(uint32_t) * kNumBanks * 256);
+        }
+    }
+
+    void ComputeHistogram(const Image &an_image, Histogram *histogram) {
+        if (histogram == nullptr) abort();
+        const size_t total_rows = an_image.num_rows();
+        const size_t total_columns = an_image.num_columns();
+
+        if (an_image.pixel_type() == PixelType::kUInt8) {
+            histogram->counts.assign(256, 0);
+            uint32_t banks[kNumBanks][256] = {};
+            uint64_t pending = 0;
+            for (size_t i = 0; i < total_rows; ++i) {
+                CountRow(an_image.Row<uint8_t>(i), total_columns, banks);
+                pending += total_columns;
+                if (pending >= kFlushInterval) {
+                    FlushBanks(banks, &histogram->counts);
+                    pending = 0;
+                }
+            }
+            FlushBanks(banks, &histogram->counts);
+            return;
+        }
+
+        const size_t num_bins = max<size_t>(256, an_image.num_gray_levels() + 1);
+        histogram->counts.assign(num_bins, 0);
+        DispatchPixelType(an_image.pixel_type(), [&](auto pixel) {
+            using T = decltype(pixel);
+            const long long last_bin = static_cast<long long>(num_bins) - 1;
+            for (size_t i = 0; i < total_rows; ++i) {
+                const T *row = an_image.Row<T>(i);
+                for (size_t j = 0; j < total_columns; ++j) {
+                    const long long value = row[j];
+                    ++histogram->counts[value < 0 ? 0 : min(value, last_bin)];
+                }
+            }
+        });
+    }
+
+    int OtsuThreshold(const Histogram &histogram) {
+        const vector<uint64_t> &counts = histogram.counts;
+        double total = 0, total_sum = 0;
+        for (size_t v = 0; v < counts.size(); ++v) {
+            total += counts[v];
+            total_sum += double(v) * counts[v];
+        }
+        if (total == 0) return 0;
+
+        //class 0 holds levels 0..k, class 1 the rest
+        double weight_0 = 0, sum_0 = 0;
+        double best_variance = -1;
+        size_t best_k = 0;
+        for (size_t k = 0; k + 1 < counts.size(); ++k) {
+            weight_0 += counts[k];
+            sum_0 += double(k) * counts[k];
+            const double weight_1 = total - weight_0;
+            if (weight_0 == 0) continue;
+            if (weight_1 == 0) break;
+            const double mean_0 = sum_0 / weight_0;
+            const double mean_1 = (total_sum - sum_0) / weight_1;
+            const double variance = weight_0 * weight_1 * (mean_0 - mean_1) * (mean_0 - mean_1);
+            if (variance > best_variance) {
+                best_variance = variance;
+                best_k = k;
+            }
+        }
+        return static_cast<int>(best_k + 1);
+    }
+
+    int TriangleThreshold(const Histogram &histogram) {
+        const vector<uint64_t> &counts = histogram.counts;
+        size_t first = 0, last = counts.size();
+        while (first < counts.size() && counts[first] == 0) ++first;
+        if (first == counts.size()) return 0;
+        while (counts[last - 1] == 0) --last;
+        --last;
+        const size_t peak = max_element(counts.begin(), counts.end()) - counts.begin();
+
+        //the line runs from the peak to the end of the longer tail
+        const bool tail_is_bright = last - peak >= peak - first;
+        const size_t end = tail_is_bright ? last : first;
+        if (end == peak) return static_cast<int>(peak + 1);
+
+        //distance of (v, counts[v]) to the line, up to a constant factor
+        const double dx = double(end) - double(peak);
+        const double dy = 0.0 - double(counts[peak]);
+        double best_distance = -1;
+        size_t best_level = peak;
+        const size_t low = min(peak, end), high = max(peak, end);
+        for (size_t v = low; v <= high; ++v) {
+            const double distance = fabs(dy * (double(v) - double(peak)) - dx * (double(counts[v]) - double(counts[peak])));
+            if (distance > best_distance) {
+                best_distance = distance;
+                best_level = v;
+            }
+        }
+        //the split level stays with the peak's class
+        return static_cast<int>(tail_is_bright ? best_level + 1 : best_level);
+    }
+}  // namespace ComputerVisionProjects
@@ -0,0 +1,47 @@
+// Gray-level histograms and automatic threshold selection.
+// To be used in Computer Vision class.
+//
+// histogram.h
+// ComputeHistogram() makes a single pass over an image; 8-bit images
+// are counted into several interleaved banks so consecutive pixels of
+// the same gray level do not wait on each other's increments.
+// OtsuThreshold() and TriangleThreshold() pick a global threshold
+// from a histogram, for ConvertToBinary().
+
+#ifndef COMPUTER_VISION_HISTOGRAM_H_
+#define COMPUTER_VISION_HISTOGRAM_H_
+
+#include "image.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace ComputerVisionProjects {
+
+// counts[v] is the number of pixels with gray level v.
+struct Histogram {
+  std::vector<uint64_t> counts;
+
+  uint64_t total() const;
+};
+
+// Counts the gray levels of an_image. 8-bit images give 256 bins,
+// other pixel types max(256, num_gray_levels() + 1) bins; values
+// outside the bins are clamped to the first or last one.
+void ComputeHistogram(const Image &an_image, Histogram *histogram);
+
+// Otsu's method: the threshold that maximizes the between-class
+// variance of the two classes it splits the histogram into.
+// Returns t such that pixels >= t are foreground, as in
+// ConvertToBinary().
+int OtsuThreshold(const Histogram &histogram);
+
+// Triangle method: draws a line from the histogram peak to the end
+// of its longer tail and splits at the bin farthest from that line.
+// Works well when the objects are a small, flat mode next to a
+// large background peak. Returns t as OtsuThreshold() does.
+int TriangleThreshold(const Histogram &histogram);
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_HISTOGRAM_H_
@@ -10,6 +10,16 @@
 
 #include "image.h"
 #include "DisjSets.h"
+#include "histogram.h"
+#include "object_database.h"
+#include "object_features.h"
+#include "object_index.h"
+#include "object_matcher.h"
+#include "labeling.h"
+#include "moments.h"
+#include "threshold.h"
+#include <cctype>
+#include <cerrno>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -18,6 +28,11 @@
 #include <fstream>
 #include <cmath>
 #include <unordered_map>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using std::unordered_map;
 
@@ -29,36 +44,191 @@ namespace ComputerVisionProjects {
         pixels_ = nullptr;
         num_rows_ = 0;
         num_columns_ = 0;
-        AllocateSpaceAndSetSize(an_image.num_rows(), an_image.num_columns());
+        row_stride_ = 0;
+        read_only_ = false;
+        AllocateSpaceAndSetSize(an_image.num_rows(), an_image.num_columns(), an_image.pixel_type());
         SetNumberGrayLevels(an_image.num_gray_levels());
 
-        for (size_t i = 0; i < num_rows(); ++i)
-            for (size_t j = 0; j < num_columns(); ++j) {
-                SetPixel(i, j, an_image.GetPixel(i, j));
-            }
+        //with the same row stride one copy moves every row,
+        //mapped images are not padded so they are copied row by row
+        if (row_stride_ == an_image.row_stride_) {
+            memcpy(pixels_, an_image.pixels_, num_rows_ * row_stride_);
+        } else {
+            const size_t row_bytes = num_columns_ * bytes_per_pixel();
+            for (size_t i = 0; i < num_rows_; ++i)
+                memcpy(pixels_ + i * row_stride_, an_image.pixels_ + i * an_image.row_stride_, row_bytes);
+        }
+    }
+
+    Image::Image(const ConstImageView &a_view) {
+        pixels_ = nullptr;
+        num_rows_ = 0;
+        num_columns_ = 0;
+        row_stride_ = 0;
+        read_only_ = false;
+        AllocateSpaceAndSetSize(a_view.num_rows(), a_view.num_columns(), a_view.pixel_type());
+        SetNumberGrayLevels(a_view.num_gray_levels());
+
+        const size_t row_bytes = num_columns_ * bytes_per_pixel();
+        for (size_t i = 0; i < num_rows_; ++i)
+            memcpy(RowBytes(i), a_view.RowBytes(i), row_bytes);
+    }
+
+    Image::Image(Image &&an_image) noexcept
+            : num_rows_{an_image.num_rows_}, num_columns_{an_image.num_columns_},
+              num_gray_levels_{an_image.num_gray_levels_}, pixel_type_{an_image.pixel_type_},
+              row_stride_{an_image.row_stride_}, pixels_{an_image.pixels_},
+              mapping_{std::move(an_image.mapping_)}, read_only_{an_image.read_only_} {
+        an_image.pixels_ = nullptr;
+        an_image.read_only_ = false;
+        an_image.num_rows_ = 0;
+        an_image.num_columns_ = 0;
+        an_image.row_stride_ = 0;
+    }
+
+    Image &Image::operator=(Image &&an_image) noexcept {
+        if (this == &an_image) return *this;
+        DeallocateSpace();
+        num_rows_ = an_image.num_rows_;
+        num_columns_ = an_image.num_columns_;
+        num_gray_levels_ = an_image.num_gray_levels_;
+        pixel_type_ = an_image.pixel_type_;
+        row_stride_ = an_image.row_stride_;
+        pixels_ = an_image.pixels_;
+        mapping_ = std::move(an_image.mapping_);
+        read_only_ = an_image.read_only_;
+        an_image.pixels_ = nullptr;
+        an_image.read_only_ = false;
+        an_image.num_rows_ = 0;
+        an_image.num_columns_ = 0;
+        an_image.row_stride_ = 0;
+        return *this;
     }
 
     Image::~Image() {
         DeallocateSpace();
     }
 
-    void Image::AllocateSpaceAndSetSize(size_t num_rows, size_t num_columns) {
+    //one aligned allocation for the whole image,
+    //every row is padded so it starts on a kRowAlignment boundary
+    void Image::AllocateSpaceAndSetSize(size_t num_rows, size_t num_columns, PixelType pixel_type) {
         if (pixels_ != nullptr) DeallocateSpace();
-        pixels_ = new int *[num_rows];
-        for (size_t i = 0; i < num_rows; ++i)
-            pixels_[i] = new int[num_columns];
-
+        const size_t row_bytes = num_columns * PixelTypeSize(pixel_type);
+        const size_t row_stride = (row_bytes + kRowAlignment - 1) / kRowAlignment * kRowAlignment;
+        const size_t total_bytes = num_rows * row_stride;
+
+        void *buffer = nullptr;
+        if (posix_memalign(&buffer, kRowAlignment, total_bytes > 0 ? total_bytes : kRowAlignment) != 0) {
+            cout << "AllocateSpaceAndSetSize: out of memory" << endl;
+            abort();
+        }
+        pixels_ = static_cast<unsigned char *>(buffer);
         num_rows_ = num_rows;
         num_columns_ = num_columns;
+        pixel_type_ = pixel_type;
+        row_stride_ = row_stride;
     }
 
     void Image::DeallocateSpace() {
-        for (size_t i = 0; i < num_rows_; i++)
-            delete pixels_[i];
-        delete pixels_;
+        //mapped pixels belong to the mapping, which unmaps itself
+        if (mapping_ == nullptr) free(pixels_);
+        mapping_.reset();
+        read_only_ = false;
         pixels_ = nullptr;
         num_rows_ = 0;
         num_columns_ = 0;
+        row_stride_ = 0;
+    }
+
+    void Image::PromoteToOwned() {
+        Image owned(*this);
+        *this = std::move(owned);
+    }
+
+    namespace {
+        //size of the stdio buffers used for pgm files
+        const size_t kFileBufferSize = 1 << 20;
+
+        //parses a binary pgm header: the magic number P5 followed by width,
+        //height and maximum gray value, separated by any whitespace and
+        //'#' comments, and exactly one whitespace character before the pixels.
+        //next_char() returns the next byte of the file or EOF.
+        template<typename NextChar>
+        bool ParsePgmHeaderFields(NextChar next_char, PgmHeader *header) {
+            if (next_char() != 'P' || next_char() != '5') return false;
+
+            size_t fields[3];
+            int c = next_char();
+            for (size_t &field: fields) {
+                bool separated = false;
+                for (;;) {
+                    if (c == '#') {
+                        while (c != '\n' && c != '\r' && c != EOF) c = next_char();
+                    } else if (isspace(c)) {
+                        c = next_char();
+                    } else {
+                        break;
+                    }
+                    separated = true;
+                }
+                if (!separated || !isdigit(c)) return false;
+                field = 0;
+                while (isdigit(c)) {
+                    field = field * 10 + (c - '0');
+                    //far beyond any sane size, avoids overflow on garbage
+                    if (field > (size_t(1) << 40)) return false;
+                    c = next_char();
+                }
+            }
+            if (!isspace(c)) return false;
+            if (fields[2] == 0 || fields[2] > 65535) return false;
+
+            header->num_columns = fields[0];
+            header->num_rows = fields[1];
+            header->max_gray = static_cast<int>(fields[2]);
+            return true;
+        }
+
+        //16-bit pgm samples are big-endian; converts a row read verbatim
+        //from the file into host order, in place
+        void BigEndianToHost(uint16_t *row, size_t num_columns) {
+            for (size_t j = 0; j < num_columns; ++j) {
+                const unsigned char *bytes = reinterpret_cast<const unsigned char *>(row + j);
+                row[j] = static_cast<uint16_t>((bytes[0] << 8) | bytes[1]);
+            }
+        }
+    }
+
+    bool ReadPgmHeader(FILE *input, PgmHeader *header) {
+        if (input == nullptr || header == nullptr) abort();
+        const long start = ftell(input);
+        if (!ParsePgmHeaderFields([input]() { return fgetc(input); }, header))
+            return false;
+        header->data_offset = static_cast<size_t>(ftell(input) - start);
+        return true;
+    }
+
+    bool ReadPgmPixels(FILE *input, const PgmHeader &header, size_t num_rows, Image *an_image) {
+        if (an_image == nullptr || num_rows > an_image->num_rows() ||
+            an_image->num_columns() != header.num_columns ||
+            an_image->bytes_per_pixel() != header.bytes_per_sample()) abort();
+
+        // read the pixels straight into the image buffer, in one call
+        // when the rows are not padded, otherwise row by row.
+        const size_t num_columns = header.num_columns;
+        const size_t row_bytes = num_columns * header.bytes_per_sample();
+        bool complete = true;
+        if (an_image->row_stride() == row_bytes) {
+            complete = fread(an_image->RowBytes(0), 1, row_bytes * num_rows, input) == row_bytes * num_rows;
+        } else {
+            for (size_t i = 0; i < num_rows && complete; ++i)
+                complete = fread(an_image->RowBytes(i), 1, row_bytes, input) == row_bytes;
+        }
+        if (complete && an_image->pixel_type() == PixelType::kUInt16) {
+            for (size_t i = 0; i < num_rows; ++i)
+                BigEndianToHost(an_image->Row<uint16_t>(i), num_columns);
+        }
+        return complete;
     }
 
     bool ReadImage(const string &filename, Image *an_image) {
@@ -68,76 +238,136 @@ namespace ComputerVisionProjects {
             cout << "ReadImage: Cannot open file" << endl;
             return false;
         }
+        setvbuf(input, nullptr, _IOFBF, kFileBufferSize);
 
-        // Check for the right "magic number".
-        char line[1024];
-        if (fread(line, 1, 3, input) != 3 || strncmp(line, "P5\n", 3)) {
+        // Check for the right "magic number" and read the sizes.
+        PgmHeader header;
+        if (!ReadPgmHeader(input, &header)) {
             fclose(input);
             cout << "ReadImage: Expected .pgm file" << endl;
             return false;
         }
+        const size_t num_rows = header.num_rows;
+        const size_t num_columns = header.num_columns;
+        const PixelType pixel_type = header.bytes_per_sample() == 2 ? PixelType::kUInt16 : PixelType::kUInt8;
+        an_image->AllocateSpaceAndSetSize(num_rows, num_columns, pixel_type);
+        an_image->SetNumberGrayLevels(header.max_gray);
 
-        // Skip comments.
-        do
-            fgets(line, sizeof line, input);
-        while (*line == '#');
-
-        // Read the width and height.
-        int num_columns, num_rows;
-        sscanf(line, "%d %d\n", &num_columns, &num_rows);
-        an_image->AllocateSpaceAndSetSize(num_rows, num_columns);
-
-
-        // Read # of gray levels.
-        fgets(line, sizeof line, input);
-        int levels;
-        sscanf(line, "%d\n", &levels);
-        an_image->SetNumberGrayLevels(levels);
-
-        // read pixel row by row.
-        for (int i = 0; i < num_rows; ++i) {
-            for (int j = 0; j < num_columns; ++j) {
-                const int byte = fgetc(input);
-                if (byte == EOF) {
-                    fclose(input);
-                    cout << "ReadImage: short file" << endl;
-                    return false;
-                }
-                an_image->SetPixel(i, j, byte);
-            }
-        }
-
+        const bool complete = ReadPgmPixels(input, header, num_rows, an_image);
         fclose(input);
+        if (!complete) {
+            cout << "ReadImage: short file" << endl;
+            return false;
+        }
         return true;
     }
 
-    bool WriteImage(const string &filename, const Image &an_image) {
-        FILE *output = fopen(filename.c_str(), "w");
-        if (output == 0) {
-            cout << "WriteImage: cannot open file" << endl;
+    bool ReadImageMapped(const string &filename, Image *an_image) {
+        if (an_image == nullptr) abort();
+        const int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            cout << "ReadImage: Cannot open file" << endl;
             return false;
         }
-        const int num_rows = an_image.num_rows();
-        const int num_columns = an_image.num_columns();
-        const int colors = an_image.num_gray_levels();
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+            close(fd);
+            return ReadImage(filename, an_image);
+        }
+        const size_t file_size = static_cast<size_t>(file_stat.st_size);
+        void *mapped = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        //the mapping keeps its own reference to the file
+        close(fd);
+        if (mapped == MAP_FAILED) return ReadImage(filename, an_image);
+        shared_ptr<const void> mapping(mapped, [file_size](const void *address) {
+            munmap(const_cast<void *>(address), file_size);
+        });
+
+        const unsigned char *bytes = static_cast<const unsigned char *>(mapped);
+        size_t position = 0;
+        PgmHeader header;
+        if (!ParsePgmHeaderFields([&]() { return position < file_size ? int(bytes[position++]) : EOF; }, &header)) {
+            cout << "ReadImage: Expected .pgm file" << endl;
+            return false;
+        }
+        header.data_offset = position;
+        if (header.bytes_per_sample() != 1) {
+            return ReadImage(filename, an_image);
+        }
+        if (file_size - header.data_offset < header.num_rows * header.num_columns) {
+            cout << "ReadImage: short file" << endl;
+            return false;
+        }
+        madvise(mapped, file_size, MADV_SEQUENTIAL);
+
+        an_image->DeallocateSpace();
+        an_image->pixels_ = const_cast<unsigned char *>(bytes + header.data_offset);
+        an_image->mapping_ = std::move(mapping);
+        an_image->read_only_ = true;
+        an_image->num_rows_ = header.num_rows;
+        an_image->num_columns_ = header.num_columns;
+        an_image->pixel_type_ = PixelType::kUInt8;
+        an_image->row_stride_ = header.num_columns;
+        an_image->SetNumberGrayLevels(header.max_gray);
+        return true;
+    }
 
-        // Write the header.
+    void WritePgmHeader(FILE *output, size_t num_rows, size_t num_columns, int colors) {
+        if (output == nullptr) abort();
         fprintf(output, "P5\n"); // Magic number.
         fprintf(output, "#\n");  // Empty comment.
-        fprintf(output, "%d %d\n%03d\n", num_columns, num_rows, colors);
-
-        for (int i = 0; i < num_rows; ++i) {
-            for (int j = 0; j < num_columns; ++j) {
-                const int byte = an_image.GetPixel(i, j);
-                if (fputc(byte, output) == EOF) {
-                    fclose(output);
-                    cout << "WriteImage: could not write" << endl;
-                    return false;
+        fprintf(output, "%zu %zu\n%03d\n", num_columns, num_rows, colors);
+    }
+
+    bool WritePgmPixels(FILE *output, const Image &an_image, size_t num_rows) {
+        if (output == nullptr || num_rows > an_image.num_rows()) abort();
+        const size_t num_columns = an_image.num_columns();
+
+        // 8-bit images are written straight from the buffer; other pixel
+        // types are narrowed to 8 bits, or to 16-bit big-endian samples
+        // when there are more than 256 gray levels, one row at a time.
+        const size_t sample_bytes = an_image.num_gray_levels() > 255 ? 2 : 1;
+        const size_t row_bytes = num_columns * sample_bytes;
+        bool complete = true;
+        if (an_image.pixel_type() == PixelType::kUInt8 && sample_bytes == 1) {
+            if (an_image.row_stride() == row_bytes) {
+                complete = fwrite(an_image.RowBytes(0), 1, row_bytes * num_rows, output) == row_bytes * num_rows;
+            } else {
+                for (size_t i = 0; i < num_rows && complete; ++i)
+                    complete = fwrite(an_image.RowBytes(i), 1, row_bytes, output) == row_bytes;
+            }
+        } else {
+            vector<unsigned char> buffer(row_bytes);
+            for (size_t i = 0; i < num_rows && complete; ++i) {
+                const unsigned char *row = an_image.RowBytes(i);
+                for (size_t j = 0; j < num_columns; ++j) {
+                    const int value = LoadPixel(row, an_image.pixel_type(), j);
+                    if (sample_bytes == 2) {
+                        buffer[2 * j] = static_cast<unsigned char>(value >> 8);
+                        buffer[2 * j + 1] = static_cast<unsigned char>(value);
+                    } else {
+                        buffer[j] = static_cast<unsigned char>(value);
+                    }
                 }
+                complete = fwrite(buffer.data(), 1, row_bytes, output) == row_bytes;
             }
         }
+        return complete;
+    }
 
-        fclose(output);
+    bool WriteImage(const string &filename, const Image &an_image) {
+        FILE *output = fopen(filename.c_str(), "wb");
+        if (output == 0) {
+            cout << "WriteImage: cannot open file" << endl;
+            return false;
+        }
+        setvbuf(output, nullptr, _IOFBF, kFileBufferSize);
+        WritePgmHeader(output, an_image.num_rows(), an_image.num_columns(), an_image.num_gray_levels());
+        const bool complete = WritePgmPixels(output, an_image, an_image.num_rows());
+        if (fclose(output) != 0 || !complete) {
+            cout << "WriteImage: could not write" << endl;
+            return false;
+        }
         return true;
     }
 
@@ -225,7 +455,9 @@ namespace ComputerVisionProjects {
         done = 0;
 
         while (!done) {
-            an_image->SetPixel(x, y, color);
+            //points outside the image are skipped
+            if (x >= 0 && y >= 0 && size_t(x) < an_image->num_rows() && size_t(y) < an_image->num_columns())
+                an_image->SetPixelUnchecked(x, y, color);
 
             // Move to the next point.
             switch (dir) {
@@ -293,330 +525,335 @@ namespace ComputerVisionProjects {
         }
     }
 
+    namespace {
+        //thresholds input into output, which has the same size and pixel type;
+        //both may be the same image. 8-bit rows go through the SIMD kernel
+        void ThresholdImage(int treshold, const Image &input, Image *output) {
+            const size_t total_rows = input.num_rows();
+            const size_t total_columns = input.num_columns();
+            if (input.pixel_type() == PixelType::kUInt8) {
+                for (size_t y = 0; y < total_rows; y++)
+                    ThresholdRow(input.Row<uint8_t>(y), output->Row<uint8_t>(y), total_columns, treshold);
+                return;
+            }
+            DispatchPixelType(input.pixel_type(), [&](auto pixel) {
+                using T = decltype(pixel);
+                for (size_t y = 0; y < total_rows; y++) {
+                    const T *in_row = input.Row<T>(y);
+                    T *out_row = output->Row<T>(y);
+                    //branch free select so the compiler can vectorize the row
+                    for (size_t x = 0; x < total_columns; x++) {
+                        out_row[x] = in_row[x] < treshold ? T(0) : T(255);
+                    }
+                }
+            });
+        }
+    }
+
 //function to convert grey image into binary image using tresholding
     void ConvertToBinary(int treshold, Image *an_image) {
-        int total_columns = an_image->num_columns();
-        int total_rows = an_image->num_rows();
-
-        for (int y = 0; y < total_rows; y++) {
-            for (int x = 0; x < total_columns; x++) {
-                if (an_image->GetPixel(y, x) < treshold) {
-                    an_image->SetPixel(y, x, 0);
-                } else {
-                    an_image->SetPixel(y, x, 255);
-                }
-            }
+        if (an_image->read_only()) {
+            //threshold straight out of the mapped pixels into a new buffer,
+            //instead of copying them first and thresholding the copy
+            const Image &input = *an_image;
+            Image binary;
+            binary.AllocateSpaceAndSetSize(input.num_rows(), input.num_columns(), input.pixel_type());
+            binary.SetNumberGrayLevels(input.num_gray_levels());
+            ThresholdImage(treshold, input, &binary);
+            *an_image = std::move(binary);
+            return;
         }
+        ThresholdImage(treshold, *an_image, an_image);
     }
 
-    void LabelBinarySequentially(Image *an_image) {
-        int total_columns = an_image->num_columns();
-        int total_rows = an_image->num_rows();
-        int greyLvl = 25;//starting grey level
-        int curr_pxl;
-        int n_pxl, nw_pxl, w_pxl;
-        int label = 0;
-        unordered_map<int, int> allGreyLvls;
-        DisjSets labeling(total_columns * total_rows);
-        vector<vector<int>> labels_map(total_columns, vector<int>(total_rows, -1));
-        vector<vector<int>> pxl_numbers(total_columns, vector<int>(total_rows, -1));
-        unordered_map<int, int> table;
+    int ConvertToBinary(ThresholdMethod method, int treshold, Image *an_image) {
+        if (method == ThresholdMethod::kBradley || method == ThresholdMethod::kSauvola) {
+            Image binary;
+            AdaptiveThreshold(method, AdaptiveThresholdOptions(), *an_image, &binary);
+            *an_image = std::move(binary);
+            return -1;
+        }
+        //one pass for the histogram, one for the threshold itself
+        treshold = SelectThreshold(method, treshold, *an_image);
+        ConvertToBinary(treshold, an_image);
+        return treshold;
+    }
+
+    int SelectThreshold(ThresholdMethod method, int treshold, const Image &an_image) {
+        if (method == ThresholdMethod::kBradley || method == ThresholdMethod::kSauvola) return -1;
+        if (method == ThresholdMethod::kFixed) return treshold;
+        Histogram histogram;
+        ComputeHistogram(an_image, &histogram);
+        return method == ThresholdMethod::kOtsu ? OtsuThreshold(histogram) : TriangleThreshold(histogram);
+    }
+
+    bool ParseThreshold(const string &text, ThresholdMethod *method, int *treshold) {
+        if (text == "otsu") {
+            *method = ThresholdMethod::kOtsu;
+            return true;
+        }
+        if (text == "triangle") {
+            *method = ThresholdMethod::kTriangle;
+            return true;
+        }
+        if (text == "bradley") {
+            *method = ThresholdMethod::kBradley;
+            return true;
+        }
+        if (text == "sauvola") {
+            *method = ThresholdMethod::kSauvola;
+            return true;
+        }
+        //a gray level is only digits, and at most the largest 16-bit one;
+        //strtol alone would also take signs, spaces and a prefix of text
+        if (text.empty() || !isdigit(static_cast<unsigned char>(text[0]))) return false;
+        char *end = nullptr;
+        errno = 0;
+        const long value = strtol(text.c_str(), &end, 10);
+        if (errno == ERANGE || *end != '\0' || value > 65535) return false;
+        *method = ThresholdMethod::kFixed;
+        *treshold = int(value);
+        return true;
+    }
+
+    int LabelBinarySequentially(const Image &binary_image, Image *label_image, Connectivity connectivity) {
+        if (label_image == nullptr) abort();
+        const size_t total_columns = binary_image.num_columns();
+        const size_t total_rows = binary_image.num_rows();
+        //provisional label of every pixel, 0 is background; they are kept
+        //in label_image until the second pass. labels are only created when
+        //a pixel starts a new component, so the equivalence table grows
+        //with the number of components, not pixels
+        label_image->AllocateSpaceAndSetSize(total_rows, total_columns, PixelType::kInt32);
+        DisjSets labeling(1);//element 0 is the background
 
         //first scan
         //will create ans assign sets based on
         //sequential labeling algorithm
         //implements disjoint sets algorithm
-        int pxl_counter = 0;
-        for (int y = 0; y < total_rows; y++) {
-            for (int x = 0; x < total_columns; x++) {
-                pxl_numbers[x][y] = pxl_counter;
-                pxl_counter++;
-
-                curr_pxl = an_image->GetPixel(y, x);
-                //if the pixel value is 0, we ignore the pixel
-                if (curr_pxl == 0) {
-                    continue;
-                } else {
-                    //we have to check the edge cases first
-                    //if we are in either the first column or row, there will be errors
-                    //we have to account for these edge cases
-                    if (x == 0 && y == 0) {
-                        //treat w_pxl, n_pxl and nw_pxl as not labeled
-                        n_pxl = -1;
-                        nw_pxl = -1;
-                        w_pxl = -1;
-                    } else if (y == 0) {
-                        //treat n_pxl and nw_pxl as not labeled
-                        n_pxl = -1;
-                        nw_pxl = -1;
-                        w_pxl = labels_map[x - 1][y];
-                    } else if (x == 0) {
-                        //treat w_pxl and nw_pxl as not labled
-                        n_pxl = labels_map[x][y - 1];
-                        nw_pxl = -1;
-                        w_pxl = -1;
-                    } else {
-                        n_pxl = labels_map[x][y - 1];
-                        nw_pxl = labels_map[x - 1][y - 1];
-                        w_pxl = labels_map[x - 1][y];
+        DispatchPixelType(binary_image.pixel_type(), [&](auto pixel) {
+            using T = decltype(pixel);
+            for (size_t y = 0; y < total_rows; y++) {
+                const T *row = binary_image.Row<T>(y);
+                uint32_t *label_row = reinterpret_cast<uint32_t *>(label_image->Row<int32_t>(y));
+                //the first row has no north neighbors
+                const uint32_t *north_row =
+                        y > 0 ? reinterpret_cast<const uint32_t *>(label_image->Row<int32_t>(y - 1)) : nullptr;
+                for (size_t x = 0; x < total_columns; x++) {
+                    //if the pixel value is 0, we ignore the pixel
+                    if (row[x] == 0) {
+                        label_row[x] = 0;
+                        continue;
                     }
-
-                    //we will now assign labels
-                    if (n_pxl == -1 && nw_pxl == -1 && w_pxl == -1) {
-                        //new label
-                        labels_map[x][y] = pxl_numbers[x][y];
-                    } else if (nw_pxl != -1) {
-                        // current pixel same set label as nw_pxl
-                        labels_map[x][y] = pxl_numbers[x][y];
-                        labeling.unionSets(labeling.find(pxl_numbers[x - 1][y - 1]), pxl_numbers[x][y]);
-
-                    } else if (n_pxl == -1 && nw_pxl == -1 && w_pxl != -1) {
-                        //current pixel set same label as w_pxl
-                        labels_map[x][y] = pxl_numbers[x][y];
-
-                        labeling.unionSets(labeling.find(pxl_numbers[x - 1][y]), pxl_numbers[x][y]);
-
-                    } else if (n_pxl != -1 && nw_pxl == -1 && w_pxl == -1) {
-                        // current pixel set same label as n_pxl
-                        labels_map[x][y] = pxl_numbers[x][y];
-                        labeling.unionSets(labeling.find(pxl_numbers[x][y - 1]), pxl_numbers[x][y]);
-                    } else if (n_pxl != -1 & nw_pxl == -1 && w_pxl != -1) {
-                        //need to see if n_pxl and w_pxl are equal or not, depending on that we will choose an action
-                        if (labeling.find(n_pxl) == labeling.find(w_pxl)) {
-                            //current pixel same as north
-                            labels_map[x][y] = pxl_numbers[x][y];
-                            labeling.unionSets(labeling.find(pxl_numbers[x][y - 1]), pxl_numbers[x][y]);
-                        } else {
-                            //This is the most important part of the code for labeling
-                            //this will take care of edge case when the north and west pixels are from different sets
-                            //this block of code will join the current pixel, north and west pixel
-                            labels_map[x][y] = pxl_numbers[x][y];
-                            int set_A = labeling.find(pxl_numbers[x][y - 1]);
-                            int set_B = labeling.find(pxl_numbers[x - 1][y]);
-                            labeling.unionSets(set_A, pxl_numbers[x][y]);
-                            labeling.unionSets(set_A, set_B);
-
-
+                    //join the labels of the already visited neighbors:
+                    //west and north, plus north west and north east
+                    //with 8-connectivity
+                    uint32_t label = x > 0 ? label_row[x - 1] : 0;
+                    if (north_row != nullptr) {
+                        const uint32_t n_pxl = north_row[x];
+                        if (n_pxl != 0 && n_pxl != label)
+                            label = label == 0 ? n_pxl : labeling.unite(label, n_pxl);
+                        //a labeled north pixel is already joined to both
+                        //diagonals, they are its west and east neighbors
+                        if (connectivity == Connectivity::kEight && n_pxl == 0) {
+                            const uint32_t nw_pxl = x > 0 ? north_row[x - 1] : 0;
+                            const uint32_t ne_pxl = x + 1 < total_columns ? north_row[x + 1] : 0;
+                            if (nw_pxl != 0 && nw_pxl != label)
+                                label = label == 0 ? nw_pxl : labeling.unite(label, nw_pxl);
+                            if (ne_pxl != 0 && ne_pxl != label)
+                                label = label == 0 ? ne_pxl : labeling.unite(label, ne_pxl);
                         }
                     }
+                    //no labeled neighbor, new label
+                    if (label == 0) {
+                        label = labeling.makeSet();
+                    }
+                    label_row[x] = label;
                 }
-
             }
-        }
+        });
 
-        int curr_pxl_label;
         //second pass
-        //will loop through all labels that are not -1 to color the pixel the correct color
-        //if pixel is -1, it is background, we ignore
-        for (int y = 0; y < total_rows; y++) {
-            for (int x = 0; x < total_columns; x++) {
-                int total_columns = an_image->num_columns();
-                int total_rows = an_image->num_rows();
-                if (labels_map[x][y] == -1) {
-                    continue;
-                }
-                curr_pxl_label = labeling.find(labels_map[x][y]);
-
-                //if the label is not in the grey lvl hashmap, then add to it
-                if (allGreyLvls.find(curr_pxl_label) == allGreyLvls.end()) {
-                    allGreyLvls[curr_pxl_label] = greyLvl;
-                    greyLvl = greyLvl + 40;
-                    an_image->SetPixel(y, x, allGreyLvls[curr_pxl_label]);
+        //components are numbered 1..N in the order of their first pixel,
+        //background pixels (label 0) stay 0
+        const int num_labels = labeling.flatten() - 1;
+        for (size_t y = 0; y < total_rows; y++) {
+            int32_t *label_row = label_image->Row<int32_t>(y);
+            for (size_t x = 0; x < total_columns; x++) label_row[x] = labeling.label(label_row[x]);
+        }
+        label_image->SetNumberGrayLevels(num_labels);
+        return num_labels;
+    }
 
-                } else {
-                    //set the pixel the correct color
-                    an_image->SetPixel(y, x, allGreyLvls[curr_pxl_label]);
+    void LabelBinarySequentially(Image *an_image, Connectivity connectivity) {
+        const int greyLvl = 25;//starting grey level
+        Image label_image;
+        LabelBinarySequentially(*an_image, &label_image, connectivity);
+        DispatchPixelType(an_image->pixel_type(), [&](auto pixel) {
+            using T = decltype(pixel);
+            for (size_t y = 0; y < an_image->num_rows(); y++) {
+                T *row = an_image->Row<T>(y);
+                const int32_t *label_row = label_image.Row<int32_t>(y);
+                for (size_t x = 0; x < an_image->num_columns(); x++) {
+                    if (label_row[x] == 0) {
+                        continue;
+                    }
+                    row[x] = static_cast<T>(greyLvl + 40 * (label_row[x] - 1));
                 }
             }
-        }
+        });
     }
 
 
-    void MakeDataset(std::string database_file_path,Image *an_image) {
-        int x_max = an_image->num_columns();
-        int y_max = an_image->num_rows();
-        //create file stream
-        ofstream out_stream;
-        out_stream.open(database_file_path, std::ofstream::trunc);
-
-        unordered_map<int, int> labeled_areas;
-        unordered_map<int, int> x_hat, y_hat;
-        unordered_map<int, float> a, a_prime, b, b_prime, c, c_prime;
-
-        //calculating values for center of object
-        for (int i = 0; i < y_max; ++i) {
-            for (int j = 0; j < x_max; ++j) {
-                int curr_pxl_label = an_image->GetPixel(i, j);
-                //if the pixel is labeled only, otherwose ignore
-                if (curr_pxl_label > 0) {
-                    //get area for each label
-                    labeled_areas[curr_pxl_label] = labeled_areas[curr_pxl_label] + 1;
-                    x_hat[curr_pxl_label] += i;
-                    y_hat[curr_pxl_label] += j;
-                    a_prime[curr_pxl_label] += pow(i, 2);
-                    b_prime[curr_pxl_label] += (i * j);
-                    c_prime[curr_pxl_label] += pow(j, 2);
-
-                }
+    namespace {
+        //writes the attributes of every object to the database and
+        //draws its center and orientation
+        void WriteDataset(const std::string &database_file_path, const MomentSums &moments, Image *an_image,
+                          DatasetMode mode) {
+            vector<ObjectFeatures> objects;
+            ComputeObjectFeatures(moments, &objects);
+
+            vector<ObjectRecord> records;
+            int label_counter = 1;
+            //loop through each object
+            for (const ObjectFeatures &object: objects) {
+                //label and attributes for the database
+                ObjectRecord record;
+                record.id = label_counter++;
+                record.center_row = object.center_row;
+                record.center_column = object.center_column;
+                record.min_moment = object.min_moment;
+                record.area = double(object.area);
+                record.roundedness = float(object.roundedness);
+                record.orientation = object.orientation;
+                records.push_back(record);
+                //draw on current image
+                DrawOrientation(object, 40, 250, an_image);
+                an_image->SetPixel(object.center_row, object.center_column, 250);
             }
+            if (mode == DatasetMode::kAppend) AppendObjectDatabaseSegment(database_file_path, records);
+            else ReplaceObjectDatabase(database_file_path, records, true);
         }
+    }
 
-        int label_counter = 1;
-        //loop through each object
-        for (auto area: labeled_areas) {
-            //key value pairs
-            int pxl_label = area.first;
-            int curr_area = area.second;
-            //center of area
-            int x_center = (x_hat[pxl_label]) / (double) curr_area;
-            int y_center = (y_hat[pxl_label]) / (double) curr_area;
-            //notice that b_prime is multiplied by 2
-            b_prime[pxl_label] *= 2;
-            //calculate values of a, b, c
-            a[pxl_label] = a_prime[pxl_label] - pow(x_center, 2) * curr_area;
-            b[pxl_label] = b_prime[pxl_label] - 2 * x_center * y_center * curr_area;
-            c[pxl_label] = c_prime[pxl_label] - pow(y_center, 2) * curr_area;
-
-            //theta, min moment, max moment
-            double theta = atan2(b[pxl_label], a[pxl_label] - c[pxl_label]) / 2;
-            double min_moment = a[pxl_label] * pow(sin(theta), 2) - b[pxl_label] * sin(theta) * cos(theta) +
-                                c[pxl_label] * pow(cos(theta), 2);
-            double theta_2 = theta + (M_PI / 2);
-            double max_moment = a[pxl_label] * pow(sin(theta_2), 2) - b[pxl_label] * sin(theta_2) * cos(theta_2) +
-                                c[pxl_label] * pow(cos(theta_2), 2);
-            float roundedness = min_moment / max_moment;
-            //write label and attributes to database
-            out_stream << label_counter++ << " ";
-            out_stream << x_center << " " << y_center << " " << min_moment << " " << curr_area << " " << roundedness << " " << theta << " "<<"\n\n";
-            int hypotenus = 40;
-            int x_orientation = x_center + hypotenus * cos(theta);
-            int y_orientation = y_center + hypotenus * sin(theta);
-            //draw on current image
-            DrawLine(x_center, y_center, x_orientation, y_orientation, 250, an_image);
-            an_image->SetPixel(x_center, y_center, 250);
-        }
-        out_stream.close();
+    void MakeDataset(std::string database_file_path,Image *an_image, int num_threads, DatasetMode mode) {
+        MomentSums moments;
+        AccumulateMoments(*an_image, &moments, num_threads);
+        WriteDataset(database_file_path, moments, an_image, mode);
     }
-//checks if num is within 35% of the ground value
-//chose this value based on testing
-    bool IsWithin35Percent(double num, double ground) {
-        double percent_diff = 0.35 * ground;
-        return num >= ground - percent_diff && num <= ground + percent_diff;
+
+    void MakeDataset(std::string database_file_path, const RunLengthLabels &labels, Image *an_image,
+                     DatasetMode mode) {
+        MomentSums moments;
+        AccumulateMoments(labels, &moments);
+        WriteDataset(database_file_path, moments, an_image, mode);
     }
 
     //The CheckObjectFromDatabase function will check for image attributes in the
     //database and will compare against the objects in the current image
     //This will label the detected images by drawing its orientation line
-    void CheckObjectFromDatabase(const string database,Image *an_image) {
-        int x_max = an_image->num_columns();
-        int y_max = an_image->num_rows();
-        //create file stream
-        ifstream in_stream;
-        in_stream.open(database);
-        string db_line;
-        unordered_map<int, string> database_map;
-        int counter = 1;
-        // Read line by line from database
-        while (getline(in_stream, db_line)) {
-            if (db_line == "") {
-                continue;
+    namespace {
+        //compares every object against the database entries and appends
+        //the ones it recognizes to detected_objects, once per record
+        void DetectObjects(const string &database, const MomentSums &moments,
+                           vector<ObjectFeatures> *detected_objects) {
+            //parsed or mapped once, then shared by every later detection
+            shared_ptr<const ObjectDatabase> records = LoadObjectDatabase(database);
+            if (records == nullptr) return;
+
+            vector<ObjectFeatures> objects;
+            ComputeObjectFeatures(moments, &objects);
+
+            //Will check the images based on minimum area and roundedness;
+            //the database stores the roundedness as a float
+            auto detected = [&](const ObjectDatabase &known_objects, const ObjectFeatures &object, uint32_t k) {
+                cout<<endl;
+                cout<<"Detected object "<<known_objects[k].id<<endl;
+                detected_objects->push_back(object);
+            };
+
+            //large databases are searched through a k-d tree, built once
+            //as well
+            shared_ptr<const ObjectIndex> index;
+            if (records->size() >= kMinIndexedRecords) index = LoadObjectIndex(database);
+            if (index != nullptr) {
+                vector<uint32_t> matches;
+                for (const ObjectFeatures &object: objects) {
+                    matches.clear();
+                    index->Match(double(object.area), float(object.roundedness), &matches);
+                    for (const uint32_t k: matches) detected(index->database(), object, k);
+                }
+                return;
             }
-            database_map[counter] = db_line;
-            //cout<<db_line<<endl;
-            counter++;
-        }
-        in_stream.close();
-
-        unordered_map<int, int> labeled_areas;
-        unordered_map<int, int> x_hat, y_hat;
-        unordered_map<int, float> a, a_prime, b, b_prime, c, c_prime;
-
-        //calculating values for center of object
-        for (int i = 0; i < y_max; ++i) {
-            for (int j = 0; j < x_max; ++j) {
-                int curr_pxl_label = an_image->GetPixel(i, j);
-                //if the pixel is labeled only
-                if (curr_pxl_label > 0) {
-                    //get area for each label
-                    labeled_areas[curr_pxl_label] = labeled_areas[curr_pxl_label] + 1;
-                    x_hat[curr_pxl_label] += i;
-                    y_hat[curr_pxl_label] += j;
-                    a_prime[curr_pxl_label] += pow(i, 2);
-                    b_prime[curr_pxl_label] += (i * j);
-                    c_prime[curr_pxl_label] += pow(j, 2);
 
+            //smaller ones are compared against all the objects at once
+            vector<double> areas(objects.size());
+            vector<double> roundedness(objects.size());
+            for (size_t o = 0; o < objects.size(); ++o) {
+                areas[o] = double(objects[o].area);
+                roundedness[o] = float(objects[o].roundedness);
+            }
+            const double *features[kNumMatchedFeatures] = {areas.data(), roundedness.data()};
+            const ObjectMatcher matcher(*records);
+            vector<uint64_t> matches;
+            matcher.MatchAll(features, objects.size(), &matches);
+            const size_t num_words = matcher.words_per_object();
+            for (size_t o = 0; o < objects.size(); ++o) {
+                for (size_t word = 0; word < num_words; ++word) {
+                    for (uint64_t bits = matches[o * num_words + word]; bits != 0; bits &= bits - 1)
+                        detected(*records, objects[o], uint32_t(word * 64 + __builtin_ctzll(bits)));
                 }
             }
         }
 
-        int label_counter = 1;
-        unordered_map<int, double> image_stats_map;
-        //loop through each object in the current image
-        for (auto area: labeled_areas) {
-            //key value pairs
-            int pxl_label = area.first;
-            int curr_area = area.second;
-
-            //center of area
-            int x_center = (x_hat[pxl_label]) / (double) curr_area;
-            int y_center = (y_hat[pxl_label]) / (double) curr_area;
-
-            //notice that b_prime is multiplied by 2
-            b_prime[pxl_label] *= 2;
-
-            //calculate values of a, b, c
-            a[pxl_label] = a_prime[pxl_label] - pow(x_center, 2) * curr_area;
-            b[pxl_label] = b_prime[pxl_label] - 2 * x_center * y_center * curr_area;
-            c[pxl_label] = c_prime[pxl_label] - pow(y_center, 2) * curr_area;
-
-            //theta, min moment, max moment
-            double theta = atan2(b[pxl_label], a[pxl_label] - c[pxl_label]) / 2;
-            double min_moment = a[pxl_label] * pow(sin(theta), 2) - b[pxl_label] * sin(theta) * cos(theta) +
-                                c[pxl_label] * pow(cos(theta), 2);
-            double theta_2 = theta + (M_PI / 2);
-            double max_moment = a[pxl_label] * pow(sin(theta_2), 2) - b[pxl_label] * sin(theta_2) * cos(theta_2) +
-                                c[pxl_label] * pow(cos(theta_2), 2);
-            float roundedness = min_moment / max_moment;
-            int hypotenus = 35;
-
-            int x_orientation = x_center + hypotenus * cos(theta);
-            int y_orientation = y_center + hypotenus * sin(theta);
-            int stat_index = 0;
-            string stat="";
-
-            //fseek(,0,SEEK_SET);
-            //getting in formation from the database hashmap
-            for (auto pair: database_map) {
-                //generating hashmap that holds the stats for object in database
-                //iterates through lines in the database
-
-                for (char c_num: pair.second) {
-                    if (c_num != ' ') {
-                        stat+=c_num;
-                    }else{
-
-                        image_stats_map[stat_index] = stod(stat);
-                        stat_index++;
-                        stat = "";
-                    }
-                }
-                stat_index=0;
-                //Will check the images based on minimum area and roundedness
-                if (IsWithin35Percent(curr_area, image_stats_map[4]) && IsWithin35Percent(roundedness, image_stats_map[5]))
-                {
-                    cout<<endl;
-                    cout<<"Detected object "<<image_stats_map[0]<<endl;
-                    DrawLine(x_center, y_center, x_orientation, y_orientation, 250, an_image);
-                }
-                image_stats_map.clear();
-            }
+        //draws the orientation of the objects DetectObjects() recognizes
+        void DetectObjects(const string &database, const MomentSums &moments, Image *an_image) {
+            vector<ObjectFeatures> detected_objects;
+            DetectObjects(database, moments, &detected_objects);
+            for (const ObjectFeatures &object: detected_objects) DrawOrientation(object, 35, 250, an_image);
         }
     }
-}  // namespace ComputerVisionProjects
 
+    void CheckObjectFromDatabase(const string database,Image *an_image, int num_threads) {
+        MomentSums moments;
+        AccumulateMoments(*an_image, &moments, num_threads);
+        DetectObjects(database, moments, an_image);
+    }
 
+    void CheckObjectFromDatabase(const string database, const RunLengthLabels &labels, Image *an_image) {
+        MomentSums moments;
+        AccumulateMoments(labels, &moments);
+        DetectObjects(database, moments, an_image);
+    }
 
+    void CheckObjectFromDatabase(const string database, const vector<ComponentMoments> &components, Image *an_image) {
+        MomentSums moments;
+        AccumulateMoments(components, &moments);
+        DetectObjects(database, moments, an_image);
+    }
 
+    void CheckObjectFromDatabase(const string database, const vector<ComponentMoments> &components,
+                                 vector<ObjectFeatures> *detected) {
+        MomentSums moments;
+        AccumulateMoments(components, &moments);
+        DetectObjects(database, moments, detected);
+    }
 
+    void CheckObjectFromDatabase(const string database, const MomentSums &moments, Image *an_image) {
+        DetectObjects(database, moments, an_image);
+    }
 
+    void MakeDataset(std::string database_file_path, const Image &label_image, int num_labels, Image *an_image,
+                     int num_threads, DatasetMode mode) {
+        MomentSums moments;
+        AccumulateMoments(label_image, num_labels, &moments, num_threads);
+        WriteDataset(database_file_path, moments, an_image, mode);
+    }
 
+    void CheckObjectFromDatabase(const string database, const Image &label_image, int num_labels, Image *an_image,
+                                 int num_threads) {
+        MomentSums moments;
+        AccumulateMoments(label_image, num_labels, &moments, num_threads);
+        DetectObjects(database, moments, an_image);
+    }
+}  // namespace ComputerVisionProjects
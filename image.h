@@ -5,14 +5,269 @@
 #ifndef COMPUTER_VISION_IMAGE_H_
 #define COMPUTER_VISION_IMAGE_H_
 
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
+#include <iterator>
+#include <memory>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
+#include <vector>
 using std::unordered_map;
 
 
 namespace ComputerVisionProjects {
+
+struct ComponentMoments;
+struct MomentSums;
+struct ObjectFeatures;
+struct RunLengthLabels;
+
+// Storage type of the pixels of an image. Gray images read from
+// 8-bit pgm files use kUInt8, deeper pgm files use kUInt16 and
+// label images use kInt32.
+enum class PixelType { kUInt8, kUInt16, kInt32 };
+
+// Returns the number of bytes used by one pixel of the given type.
+inline size_t PixelTypeSize(PixelType pixel_type) {
+  switch (pixel_type) {
+    case PixelType::kUInt8: return sizeof(uint8_t);
+    case PixelType::kUInt16: return sizeof(uint16_t);
+    default: return sizeof(int32_t);
+  }
+}
  
+// Reads pixel j of a row whose pixels are stored as pixel_type.
+inline int LoadPixel(const unsigned char *row, PixelType pixel_type, size_t j) {
+  switch (pixel_type) {
+    case PixelType::kUInt8: return row[j];
+    case PixelType::kUInt16: return reinterpret_cast<const uint16_t *>(row)[j];
+    default: return reinterpret_cast<const int32_t *>(row)[j];
+  }
+}
+
+// Writes value into pixel j of a row whose pixels are stored
+// as pixel_type; the value wraps if it does not fit.
+inline void StorePixel(unsigned char *row, PixelType pixel_type, size_t j,
+                       int value) {
+  switch (pixel_type) {
+    case PixelType::kUInt8:
+      row[j] = static_cast<uint8_t>(value);
+      break;
+    case PixelType::kUInt16:
+      reinterpret_cast<uint16_t *>(row)[j] = static_cast<uint16_t>(value);
+      break;
+    default:
+      reinterpret_cast<int32_t *>(row)[j] = value;
+  }
+}
+
+// Non-owning view of the pixels of one image row.
+// Supports range-based for loops over the row:
+//   for (uint8_t &pixel : one_image.Span<uint8_t>(i)) pixel = 0;
+template <typename T>
+class RowSpan {
+ public:
+  RowSpan(T *data, size_t size): data_{data}, size_{size} { }
+  // A mutable span converts to a read-only one.
+  template <typename U,
+            typename = typename std::enable_if<
+                std::is_same<const U, T>::value>::type>
+  RowSpan(const RowSpan<U> &other): data_{other.data()}, size_{other.size()} { }
+
+  T *data() const { return data_; }
+  size_t size() const { return size_; }
+  T *begin() const { return data_; }
+  T *end() const { return data_ + size_; }
+
+  // Bounds are only checked in debug builds.
+  T &operator[](size_t j) const {
+    assert(j < size_);
+    return data_[j];
+  }
+
+ private:
+  T *data_;
+  size_t size_;
+};
+
+// Range over all the rows of an image, top to bottom, yielding
+// one RowSpan per row. T is const-qualified for read-only access.
+template <typename T>
+class RowRange {
+ public:
+  using Byte = typename std::conditional<std::is_const<T>::value,
+                                         const unsigned char,
+                                         unsigned char>::type;
+
+  class Iterator {
+   public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = RowSpan<T>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = RowSpan<T>;
+
+    Iterator(Byte *row, size_t stride, size_t num_columns)
+        : row_{row}, stride_{stride}, num_columns_{num_columns} { }
+
+    RowSpan<T> operator*() const {
+      return RowSpan<T>(reinterpret_cast<T *>(row_), num_columns_);
+    }
+    Iterator &operator++() {
+      row_ += stride_;
+      return *this;
+    }
+    bool operator==(const Iterator &other) const { return row_ == other.row_; }
+    bool operator!=(const Iterator &other) const { return row_ != other.row_; }
+
+   private:
+    Byte *row_;
+    size_t stride_;
+    size_t num_columns_;
+  };
+
+  RowRange(Byte *first_row, size_t num_rows, size_t stride, size_t num_columns)
+      : first_row_{first_row}, num_rows_{num_rows},
+        stride_{stride}, num_columns_{num_columns} { }
+
+  Iterator begin() const { return Iterator(first_row_, stride_, num_columns_); }
+  Iterator end() const {
+    return Iterator(first_row_ + num_rows_ * stride_, stride_, num_columns_);
+  }
+  size_t size() const { return num_rows_; }
+
+ private:
+  Byte *first_row_;
+  size_t num_rows_;
+  size_t stride_;
+  size_t num_columns_;
+};
+
+// Non-owning view of a rectangular region (ROI) of an image.
+// A view is only a pointer, a size and a row stride, so it is
+// cheap to copy and to pass by value; it stays valid as long as
+// the image it was taken from is neither resized nor destroyed.
+// Byte is const-qualified for read-only views (ConstImageView),
+// whose rows and pixels can only be read. A writable view converts
+// to a read-only one.
+// Sample usage:
+//   // Thresholds only a 100x100 window starting at row 20, column 30.
+//   ImageView window = an_image.View(20, 30, 100, 100);
+//   for (RowSpan<uint8_t> row : window.Rows<uint8_t>()) ...
+template <typename Byte>
+class BasicImageView {
+ public:
+  // Pixels of type T as seen through this view: const T for
+  // read-only views.
+  template <typename T>
+  using Pixel = typename std::conditional<std::is_const<Byte>::value,
+                                          const T, T>::type;
+
+  BasicImageView(): num_rows_{0}, num_columns_{0}, num_gray_levels_{0},
+                    pixel_type_{PixelType::kUInt8}, row_stride_{0},
+                    pixels_{nullptr} { }
+  BasicImageView(Byte *pixels, size_t num_rows, size_t num_columns,
+                 size_t row_stride, PixelType pixel_type,
+                 size_t num_gray_levels)
+      : num_rows_{num_rows}, num_columns_{num_columns},
+        num_gray_levels_{num_gray_levels}, pixel_type_{pixel_type},
+        row_stride_{row_stride}, pixels_{pixels} { }
+  // A writable view converts to a read-only one.
+  template <typename U,
+            typename = typename std::enable_if<
+                std::is_same<const U, Byte>::value>::type>
+  BasicImageView(const BasicImageView<U> &other)
+      : BasicImageView(other.RowBytes(0), other.num_rows(),
+                       other.num_columns(), other.row_stride(),
+                       other.pixel_type(), other.num_gray_levels()) { }
+
+  size_t num_rows() const { return num_rows_; }
+  size_t num_columns() const { return num_columns_; }
+  size_t num_gray_levels() const { return num_gray_levels_; }
+  PixelType pixel_type() const { return pixel_type_; }
+  size_t bytes_per_pixel() const { return PixelTypeSize(pixel_type_); }
+  size_t row_stride() const { return row_stride_; }
+
+  // Sub-region of this view; the rectangle has to lie inside it.
+  BasicImageView SubView(size_t first_row, size_t first_column,
+                         size_t num_rows, size_t num_columns) const {
+    if (first_row + num_rows > num_rows_ ||
+        first_column + num_columns > num_columns_) abort();
+    return BasicImageView(pixels_ + first_row * row_stride_ +
+                              first_column * bytes_per_pixel(),
+                          num_rows, num_columns, row_stride_, pixel_type_,
+                          num_gray_levels_);
+  }
+
+  void SetPixel(size_t i, size_t j, int gray_level) {
+    if (i >= num_rows_ || j >= num_columns_) abort();
+    SetPixelUnchecked(i, j, gray_level);
+  }
+  int GetPixel(size_t i, size_t j) const {
+    if (i >= num_rows_ || j >= num_columns_) abort();
+    return GetPixelUnchecked(i, j);
+  }
+  void SetPixelUnchecked(size_t i, size_t j, int gray_level) {
+    static_assert(!std::is_const<Byte>::value,
+                  "the pixels of a read-only view cannot be set");
+    assert(i < num_rows_ && j < num_columns_);
+    StorePixel(RowBytes(i), pixel_type_, j, gray_level);
+  }
+  int GetPixelUnchecked(size_t i, size_t j) const {
+    assert(i < num_rows_ && j < num_columns_);
+    return LoadPixel(RowBytes(i), pixel_type_, j);
+  }
+
+  Byte *RowBytes(size_t i) { return pixels_ + i * row_stride_; }
+  const unsigned char *RowBytes(size_t i) const {
+    return pixels_ + i * row_stride_;
+  }
+  template <typename T>
+  Pixel<T> *Row(size_t i) {
+    assert(sizeof(T) == bytes_per_pixel());
+    return reinterpret_cast<Pixel<T> *>(RowBytes(i));
+  }
+  template <typename T>
+  const T *Row(size_t i) const {
+    assert(sizeof(T) == bytes_per_pixel());
+    return reinterpret_cast<const T *>(RowBytes(i));
+  }
+  template <typename T>
+  RowSpan<Pixel<T>> Span(size_t i) {
+    assert(i < num_rows_);
+    return RowSpan<Pixel<T>>(Row<T>(i), num_columns_);
+  }
+  template <typename T>
+  RowSpan<const T> Span(size_t i) const {
+    assert(i < num_rows_);
+    return RowSpan<const T>(Row<T>(i), num_columns_);
+  }
+  template <typename T>
+  RowRange<Pixel<T>> Rows() {
+    assert(sizeof(T) == bytes_per_pixel());
+    return RowRange<Pixel<T>>(pixels_, num_rows_, row_stride_, num_columns_);
+  }
+  template <typename T>
+  RowRange<const T> Rows() const {
+    assert(sizeof(T) == bytes_per_pixel());
+    return RowRange<const T>(pixels_, num_rows_, row_stride_, num_columns_);
+  }
+
+ private:
+  size_t num_rows_;
+  size_t num_columns_;
+  size_t num_gray_levels_;
+  PixelType pixel_type_;
+  size_t row_stride_;
+  Byte *pixels_;
+};
+
+typedef BasicImageView<unsigned char> ImageView;
+typedef BasicImageView<const unsigned char> ConstImageView;
+
 // Class for representing a gray-scale image.
 // Sample usage:
 //   Image one_image;
@@ -24,19 +279,40 @@ namespace ComputerVisionProjects {
 //       one_image.SetPixel(i, j, 150);
 //   WriteImage("output_file.pgm", an_image);
 //   // See image_demo.cc for read/write image.
+//
+// Pixels are kept in a single contiguous buffer aligned to
+// kRowAlignment bytes. Every row starts row_stride() bytes after
+// the previous one, so rows can be walked with plain pointers:
+//   uint8_t *row = one_image.Row<uint8_t>(i);
+//   for (size_t j = 0; j < one_image.num_columns(); ++j) row[j] = 150;
 class Image {
  public:
+  // Alignment in bytes of the buffer and of the start of every row.
+  static constexpr size_t kRowAlignment = 64;
+
   Image(): num_rows_{0}, num_columns_{0}, 
-	   num_gray_levels_{0}, pixels_{nullptr} { }
+	   num_gray_levels_{0}, pixel_type_{PixelType::kUInt8},
+	   row_stride_{0}, pixels_{nullptr}, read_only_{false} { }
   
+  // Deep copy; the pixels are copied with memcpy.
   Image(const Image &an_image);
+  // Deep copy of the region seen by a view, packed into a new buffer.
+  explicit Image(const ConstImageView &a_view);
   Image& operator=(const Image &an_image) = delete;
 
+  // Moves take over the pixel buffer without copying it;
+  // the moved-from image is left empty.
+  Image(Image &&an_image) noexcept;
+  Image& operator=(Image &&an_image) noexcept;
+
   ~Image();
 
   // Sets the size of the image to the given
   // height (num_rows) and columns (num_columns).
-  void AllocateSpaceAndSetSize(size_t num_rows, size_t num_columns);
+  // Pixels are stored with the given pixel_type; their values
+  // are left uninitialized.
+  void AllocateSpaceAndSetSize(size_t num_rows, size_t num_columns,
+                               PixelType pixel_type = PixelType::kUInt8);
 
   size_t num_rows() const { return num_rows_; }
   size_t num_columns() const { return num_columns_; }
@@ -44,53 +320,303 @@ class Image {
   void SetNumberGrayLevels(size_t gray_levels) {
     num_gray_levels_ = gray_levels;
   }
+  PixelType pixel_type() const { return pixel_type_; }
+  size_t bytes_per_pixel() const { return PixelTypeSize(pixel_type_); }
+  // Distance in bytes between the starts of two consecutive rows.
+  size_t row_stride() const { return row_stride_; }
+
+  // True while the pixels are a read-only mapping of a file (see
+  // ReadImageMapped()). The first call to a mutating accessor --
+  // SetPixel(), the non-const RowBytes(), Row(), Span(), Rows() or
+  // View() -- copies them into an owned buffer; read through a
+  // const Image to avoid that copy.
+  bool read_only() const { return read_only_; }
+  void EnsureWritable() {
+    if (read_only_) PromoteToOwned();
+  }
  
   // Sets the pixel in the image at row i and column j
-  // to a particular gray_level.
+  // to a particular gray_level. The value is converted to
+  // pixel_type(), so it wraps if it does not fit.
   void SetPixel(size_t i, size_t j, int gray_level) {
     if (i >= num_rows_ || j >= num_columns_) abort();
-    pixels_[i][j] = gray_level;
+    SetPixelUnchecked(i, j, gray_level);
   }
 
   int GetPixel(size_t i, size_t j) const {
     if (i >= num_rows_ || j >= num_columns_) abort();
-    return pixels_[i][j];
+    return GetPixelUnchecked(i, j);
+  }
+
+  // Same as SetPixel()/GetPixel(), but the coordinates are only
+  // checked by assertions in debug builds. Meant for inner loops
+  // whose indices are already known to be inside the image.
+  void SetPixelUnchecked(size_t i, size_t j, int gray_level) {
+    assert(i < num_rows_ && j < num_columns_);
+    StorePixel(RowBytes(i), pixel_type_, j, gray_level);
+  }
+
+  int GetPixelUnchecked(size_t i, size_t j) const {
+    assert(i < num_rows_ && j < num_columns_);
+    return LoadPixel(RowBytes(i), pixel_type_, j);
+  }
+
+  // Raw access to the first byte of row i.
+  unsigned char *RowBytes(size_t i) {
+    EnsureWritable();
+    return pixels_ + i * row_stride_;
+  }
+  const unsigned char *RowBytes(size_t i) const {
+    return pixels_ + i * row_stride_;
+  }
+
+  // Typed access to the first pixel of row i; T has to match
+  // pixel_type() (uint8_t, uint16_t or int32_t).
+  template <typename T>
+  T *Row(size_t i) {
+    assert(sizeof(T) == bytes_per_pixel());
+    return reinterpret_cast<T *>(RowBytes(i));
+  }
+  template <typename T>
+  const T *Row(size_t i) const {
+    assert(sizeof(T) == bytes_per_pixel());
+    return reinterpret_cast<const T *>(RowBytes(i));
+  }
+
+  // Row i as a span of num_columns() pixels of type T.
+  template <typename T>
+  RowSpan<T> Span(size_t i) {
+    assert(i < num_rows_);
+    return RowSpan<T>(Row<T>(i), num_columns_);
+  }
+  template <typename T>
+  RowSpan<const T> Span(size_t i) const {
+    assert(i < num_rows_);
+    return RowSpan<const T>(Row<T>(i), num_columns_);
+  }
+
+  // All the rows of the image, so kernels can be written as
+  //   for (RowSpan<uint8_t> row : one_image.Rows<uint8_t>())
+  //     for (uint8_t &pixel : row) ...
+  template <typename T>
+  RowRange<T> Rows() {
+    assert(sizeof(T) == bytes_per_pixel());
+    EnsureWritable();
+    return RowRange<T>(pixels_, num_rows_, row_stride_, num_columns_);
+  }
+  template <typename T>
+  RowRange<const T> Rows() const {
+    assert(sizeof(T) == bytes_per_pixel());
+    return RowRange<const T>(pixels_, num_rows_, row_stride_, num_columns_);
+  }
+
+  // Views of the whole image or of the rectangle of num_rows x
+  // num_columns pixels whose top-left corner is (first_row,
+  // first_column). No pixels are copied; views of a const image
+  // are ConstImageViews and only hand out read-only rows.
+  ImageView View() {
+    EnsureWritable();
+    return ImageView(pixels_, num_rows_, num_columns_, row_stride_,
+                     pixel_type_, num_gray_levels_);
+  }
+  ConstImageView View() const {
+    return ConstImageView(pixels_, num_rows_, num_columns_, row_stride_,
+                          pixel_type_, num_gray_levels_);
+  }
+  ImageView View(size_t first_row, size_t first_column,
+                 size_t num_rows, size_t num_columns) {
+    return View().SubView(first_row, first_column, num_rows, num_columns);
+  }
+  ConstImageView View(size_t first_row, size_t first_column,
+                      size_t num_rows, size_t num_columns) const {
+    return View().SubView(first_row, first_column, num_rows, num_columns);
   }
 
  private:
+  friend bool ReadImageMapped(const std::string &input_filename,
+                              Image *an_image);
+
   void DeallocateSpace();
+  void PromoteToOwned();
 
   size_t num_rows_; 
   size_t num_columns_; 
   size_t num_gray_levels_;  
-  int **pixels_;
+  PixelType pixel_type_;
+  size_t row_stride_;
+  unsigned char *pixels_;
+  // Set for memory-mapped images; keeps the mapping alive.
+  std::shared_ptr<const void> mapping_;
+  bool read_only_;
+};
+
+// Calls fn with a value-initialized pixel of the C++ type that
+// corresponds to pixel_type, so a generic lambda can be
+// instantiated once per storage type:
+//   DispatchPixelType(an_image.pixel_type(), [&](auto pixel) {
+//     using T = decltype(pixel);
+//     const T *row = an_image.Row<T>(0);
+//     ...
+//   });
+template <typename Fn>
+void DispatchPixelType(PixelType pixel_type, Fn fn) {
+  switch (pixel_type) {
+    case PixelType::kUInt8: fn(uint8_t{}); break;
+    case PixelType::kUInt16: fn(uint16_t{}); break;
+    default: fn(int32_t{}); break;
+  }
+}
+// Header fields of a binary (P5) pgm file.
+struct PgmHeader {
+  size_t num_columns;
+  size_t num_rows;
+  int max_gray;
+  // Offset of the first pixel byte from where parsing started.
+  size_t data_offset;
+
+  // Files with more than 256 gray levels store 16-bit big-endian samples.
+  size_t bytes_per_sample() const { return max_gray > 255 ? 2 : 1; }
 };
+
+// Parses a pgm header at the current position of input, allowing
+// any number of comments and any whitespace between the fields.
+// On success input is left at the first pixel byte.
+bool ReadPgmHeader(FILE *input, PgmHeader *header);
+
+// Reads the next num_rows rows of pixels described by header from
+// input into the first num_rows rows of an_image, which has to be
+// allocated with header.num_columns columns and a pixel type of
+// header.bytes_per_sample() bytes. 16-bit samples are converted
+// from big-endian. Returns false on a short file.
+bool ReadPgmPixels(FILE *input, const PgmHeader &header, size_t num_rows,
+                   Image *an_image);
+
+// Writes a pgm header for an image of num_rows x num_columns pixels
+// with colors gray levels, as WriteImage() does.
+void WritePgmHeader(FILE *output, size_t num_rows, size_t num_columns,
+                    int colors);
+
+// Writes the first num_rows rows of an_image to output as pgm
+// samples: 16-bit big-endian ones when an_image has more than 256
+// gray levels, 8-bit ones otherwise. Together with WritePgmHeader()
+// an image can be written a strip at a time.
+// Returns true if  everyhing is OK, false otherwise.
+bool WritePgmPixels(FILE *output, const Image &an_image, size_t num_rows);
+
 // Reads a pgm image from file input_filename.
+// 8-bit files give kUInt8 images, 16-bit files kUInt16 images.
 // an_image is the resulting image.
 // Returns true if  everyhing is OK, false otherwise.
 bool ReadImage(const std::string &input_filename, Image *an_image);
 
+// Same as ReadImage(), but 8-bit files are memory-mapped instead of
+// read: an_image becomes a read-only view of the page cache and
+// loading costs only the header parse. The pixels are copied the
+// first time an_image is modified (see Image::read_only()).
+// 16-bit files, which need byte swapping, fall back to ReadImage().
+bool ReadImageMapped(const std::string &input_filename, Image *an_image);
+
 // Writes image an_iamge into the pgm file output_filename.
+// Images with more than 256 gray levels are written with 16-bit samples.
 // Returns true if  everyhing is OK, false otherwise.
 bool WriteImage(const std::string &output_filename, const Image &an_image);
 
 //  Draws a line of given gray-level color from (x0,y0) to (x1,y1);
 //  an_image is the input/output image. 
 // IMPORTANT: (x0,y0) and (x1,y1) can lie outside the image 
-//   boundaries, so SetPixel() should check the coordinates passed to it.
+//   boundaries; the points of the line outside them are not drawn.
 void DrawLine(int x0, int y0, int x1, int y1, int color,
 	      Image *an_image);
 
 // convert grey values into binary either 0 or 255
 void ConvertToBinary(int treshold,Image *an_image);
-//labels a binary image. it uses sequential labeling with disjoint sets
-void LabelBinarySequentially(Image *an_image);
+
+// How ConvertToBinary() picks its threshold: kFixed uses the value
+// it is given, kOtsu and kTriangle select one from the image
+// histogram (see histogram.h), kBradley and kSauvola threshold
+// each pixel against its neighborhood (see threshold.h).
+enum class ThresholdMethod { kFixed, kOtsu, kTriangle, kBradley, kSauvola };
+
+// Returns the global threshold method picks for an_image without
+// thresholding it: treshold itself for kFixed, -1 for the local
+// methods.
+int SelectThreshold(ThresholdMethod method, int treshold,
+                    const Image &an_image);
+
+// convert grey values into binary with the given method;
+// treshold is only used by kFixed. Returns the threshold used,
+// or -1 for the local methods.
+int ConvertToBinary(ThresholdMethod method, int treshold, Image *an_image);
+
+// Parses a threshold given on the command line: either a gray
+// level, a whole number from 0 to 65535 written with digits only,
+// or the name of a method ("otsu", "triangle", "bradley",
+// "sauvola").
+// Returns false if text is neither.
+bool ParseThreshold(const std::string &text, ThresholdMethod *method,
+                    int *treshold);
+// Which neighbors of a foreground pixel belong to its component:
+// kFour only north, south, east and west, kEight also the diagonals.
+enum class Connectivity { kFour, kEight };
+
+//labels a binary image into label_image, resized to its size with
+//PixelType::kInt32 pixels: 0 for the background and 1..N for the
+//components, in the raster order of their first pixel. Returns N.
+//it uses sequential labeling with disjoint sets
+int LabelBinarySequentially(const Image &binary_image, Image *label_image,
+                            Connectivity connectivity = Connectivity::kEight);
+//labels a binary image in place: every component is drawn with its own
+//gray level, 25 + 40 * (label - 1). Use RenderLabels() (labeling.h) to
+//draw a label image the same way
+void LabelBinarySequentially(Image *an_image,
+                             Connectivity connectivity = Connectivity::kEight);
+//how MakeDataset() stores the objects: kReplace rewrites the database
+//and drops the segments appended to the old one, kAppend adds them as
+//a new segment that CompactObjectDatabase() merges in later, so
+//several processes can enroll objects at once (see object_database.h)
+enum class DatasetMode { kReplace, kAppend };
 //creates a dataset of attributes based on image labels
-//and marks image by its orientation
-void MakeDataset( std::string database_file_path,Image *an_image) ;
+//and marks image by its orientation. the moments of the objects are
+//accumulated on num_threads threads (0: one per hardware thread), with
+//the same result for any number
+void MakeDataset( std::string database_file_path,Image *an_image,
+                  int num_threads = 1,
+                  DatasetMode mode = DatasetMode::kReplace) ;
+//same from the runs of LabelRunLength(), computing the attributes per run;
+//an_image is only drawn on
+void MakeDataset(std::string database_file_path, const RunLengthLabels &labels,
+                 Image *an_image, DatasetMode mode = DatasetMode::kReplace);
+//same from a label image of LabelBinarySequentially(), with labels
+//1..num_labels; an_image is only drawn on
+void MakeDataset(std::string database_file_path, const Image &label_image,
+                 int num_labels, Image *an_image, int num_threads = 1,
+                 DatasetMode mode = DatasetMode::kReplace);
 //detects images based on database attributes
-//will mark detected object
-void CheckObjectFromDatabase(std::string database,Image *an_image);
+//will mark detected object. num_threads as in MakeDataset()
+void CheckObjectFromDatabase(std::string database,Image *an_image,
+                             int num_threads = 1);
+//same from the runs of LabelRunLength(); an_image is only drawn on
+void CheckObjectFromDatabase(std::string database,
+                             const RunLengthLabels &labels, Image *an_image);
+//same from a label image of LabelBinarySequentially(); an_image is only
+//drawn on
+void CheckObjectFromDatabase(std::string database, const Image &label_image,
+                             int num_labels, Image *an_image,
+                             int num_threads = 1);
+//same from the moments of components that were never written to an
+//image, e.g. from LabelThresholded(); an_image is only drawn on
+void CheckObjectFromDatabase(std::string database,
+                             const std::vector<ComponentMoments> &components,
+                             Image *an_image);
+//same, but the recognized objects are appended to detected instead of
+//being drawn, for images that are never in memory as a whole
+void CheckObjectFromDatabase(std::string database,
+                             const std::vector<ComponentMoments> &components,
+                             std::vector<ObjectFeatures> *detected);
+//same from moments indexed by label, e.g. from a FrameSequenceLabeler;
+//labels with no pixels are skipped. an_image is only drawn on
+void CheckObjectFromDatabase(std::string database, const MomentSums &moments,
+                             Image *an_image);
 
 
 }  // namespace ComputerVisionProjects
@@ -0,0 +1,404 @@
+//
+// labeling.cc
+// Connected-component labeling engines.
+//
+
+#include "labeling.h"
+#include "DisjSets.h"
+#include "parallel.h"
+#include "threshold.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+namespace ComputerVisionProjects {
+
+    void AppendThresholdedRuns(const uint8_t *row, size_t num_columns, uint32_t y, int treshold,
+                               vector<uint64_t> *bits, vector<Run> *runs) {
+        ThresholdRowToBits(row, bits->data(), num_columns, treshold);
+        const size_t num_words = bits->size();
+        //find the next set bit (start) or clear bit (end) from column x
+        auto next = [&](size_t x, bool set) {
+            while (x < num_columns) {
+                const uint64_t word = set ? (*bits)[x / 64] : ~(*bits)[x / 64];
+                const uint64_t remaining = word >> (x % 64);
+                if (remaining != 0) return min(num_columns, x + __builtin_ctzll(remaining));
+                x = (x / 64 + 1) * 64;
+                if (x / 64 >= num_words) return num_columns;
+            }
+            return num_columns;
+        };
+        size_t x = next(0, true);
+        while (x < num_columns) {
+            const size_t end = next(x, false);
+            runs->push_back({y, uint32_t(x), uint32_t(end - 1), 0});
+            x = next(end, true);
+        }
+    }
+
+    namespace {
+        //appends the foreground (nonzero) runs of one row; 8-bit rows are
+        //packed into bits first
+        template<typename T>
+        void AppendForegroundRuns(const T *row, size_t num_columns, uint32_t y, vector<uint64_t> *, vector<Run> *runs) {
+            AppendRuns(row, num_columns, y, [](T value) { return value != 0; }, runs);
+        }
+
+        void AppendForegroundRuns(const uint8_t *row, size_t num_columns, uint32_t y, vector<uint64_t> *bits, vector<Run> *runs) {
+            AppendThresholdedRuns(row, num_columns, y, 1, bits, runs);
+        }
+    }
+
+    void LabelRunLength(const Image &binary_image, RunLengthLabels *labels, Connectivity connectivity) {
+        if (labels == nullptr) abort();
+        const size_t total_rows = binary_image.num_rows();
+        const size_t total_columns = binary_image.num_columns();
+        labels->num_rows = total_rows;
+        labels->num_columns = total_columns;
+        labels->runs.clear();
+        labels->row_starts.assign(1, 0);
+
+        //encode every row as runs
+        vector<uint64_t> bits((total_columns + 63) / 64);
+        DispatchPixelType(binary_image.pixel_type(), [&](auto pixel) {
+            using T = decltype(pixel);
+            for (size_t y = 0; y < total_rows; y++) {
+                AppendForegroundRuns(binary_image.Row<T>(y), total_columns, uint32_t(y), &bits, &labels->runs);
+                labels->row_starts.push_back(labels->runs.size());
+            }
+        });
+
+        //a run joins every run of the row above that overlaps it, or with
+        //8-connectivity ends right before it (north west) or starts right
+        //after it (north east); runs of both rows are sorted, so the
+        //touching ones are found by walking the two lists together
+        const uint32_t reach = connectivity == Connectivity::kEight ? 1 : 0;
+        vector<Run> &runs = labels->runs;
+        DisjSets equivalences(1);//element 0 is the background
+        for (size_t y = 0; y < total_rows; y++) {
+            size_t above = y > 0 ? labels->row_starts[y - 1] : 0;
+            const size_t above_end = y > 0 ? labels->row_starts[y] : 0;
+            for (size_t r = labels->row_starts[y]; r < labels->row_starts[y + 1]; ++r) {
+                Run &run = runs[r];
+                //skip runs that end before the first neighbor of run.first
+                while (above < above_end && runs[above].last + reach < run.first) ++above;
+                uint32_t label = 0;
+                for (size_t k = above; k < above_end && runs[k].first <= run.last + reach; ++k) {
+                    label = label == 0 ? runs[k].label : equivalences.unite(label, runs[k].label);
+                }
+                run.label = label != 0 ? label : equivalences.makeSet();
+                //the last touching run may also touch the next run
+                while (above < above_end && runs[above].last < run.last) ++above;
+            }
+        }
+
+        //final labels in the order of the first run of each component
+        labels->num_labels = equivalences.flatten() - 1;
+        for (Run &run: runs) run.label = equivalences.label(run.label);
+    }
+
+    void RenderLabels(const RunLengthLabels &labels, Image *an_image) {
+        if (an_image == nullptr) abort();
+        an_image->AllocateSpaceAndSetSize(labels.num_rows, labels.num_columns);
+        an_image->SetNumberGrayLevels(255);
+        for (size_t y = 0; y < labels.num_rows; y++)
+            memset(an_image->Row<uint8_t>(y), 0, labels.num_columns);
+        for (const Run &run: labels.runs) {
+            uint8_t *row = an_image->Row<uint8_t>(run.row);
+            const uint8_t gray_level = static_cast<uint8_t>(25 + 40 * (int(run.label) - 1));
+            memset(row + run.first, gray_level, run.last - run.first + 1);
+        }
+    }
+
+    namespace {
+        //row pointers of a binary image, so that neighbor reads are a
+        //single load; pixels outside the image are background
+        template<typename T>
+        class BinaryRows {
+        public:
+            explicit BinaryRows(const Image &binary_image)
+                    : rows_(binary_image.num_rows()), columns_(binary_image.num_columns()) {
+                row_pointers_.reserve(rows_);
+                for (size_t y = 0; y < rows_; y++) row_pointers_.push_back(binary_image.Row<T>(y));
+            }
+            bool operator()(long y, long x) const {
+                return y >= 0 && x >= 0 && size_t(y) < rows_ && size_t(x) < columns_ && row_pointers_[y][x] != 0;
+            }
+        private:
+            size_t rows_, columns_;
+            vector<const T *> row_pointers_;
+        };
+
+        //a horizontal stripe of the image, labeled on its own with its own
+        //provisional labels
+        struct Stripe {
+            long first_row = 0;
+            long end_row = 0;
+            DisjSets equivalences{1};//element 0 is the background
+            //raster index of the first pixel of every provisional label
+            vector<uint64_t> first_pixel{0};
+            //number of labels of the stripe after flatten, and the number
+            //in the whole image of its label 0
+            int num_labels = 0;
+            int label_offset = 0;
+            //final label of every provisional label
+            vector<int32_t> final_labels;
+        };
+
+        //8-connectivity on 2x2 blocks; block_labels gets the provisional
+        //label of every block of the stripe, 0 for blocks with no foreground
+        template<typename T>
+        void LabelBlocks(const BinaryRows<T> &fg, long total_columns, size_t block_columns,
+                         uint32_t *block_labels, Stripe *stripe) {
+            //block X has pixels a b / c d, its north neighbors are the bottom
+            //row of blocks P Q R and its west neighbors the right column of S:
+            //  . g | h i | j
+            //  ----+-----+--
+            //  . s | a b
+            //  . t | c d
+            for (long y = stripe->first_row; y < stripe->end_row; y += 2) {
+                //the row above the stripe belongs to another stripe
+                const bool has_north = y > stripe->first_row;
+                for (long x = 0; x < total_columns; x += 2) {
+                    const size_t block = (y / 2) * block_columns + x / 2;
+                    const size_t north = block - block_columns;//only read when has_north
+                    const bool a = fg(y, x), b = fg(y, x + 1);
+                    const bool c = fg(y + 1, x), d = fg(y + 1, x + 1);
+                    if (!(a || b || c || d)) continue;
+                    uint32_t label = 0;
+                    auto join = [&](uint32_t other) {
+                        label = label == 0 ? other : stripe->equivalences.unite(label, other);
+                    };
+                    //a and b both touch h and i
+                    bool h = false, i = false, g = false;
+                    if (has_north && (a || b)) {
+                        h = fg(y - 1, x);
+                        i = fg(y - 1, x + 1);
+                        if (h || i) join(block_labels[north]);
+                    }
+                    //g only touches a; if h is set, P was joined to Q
+                    //when Q was labeled
+                    if (has_north && a && !h) {
+                        g = fg(y - 1, x - 1);
+                        if (g) join(block_labels[north - 1]);
+                    }
+                    //j only touches b; if i is set, R was joined to Q
+                    if (has_north && b && !i && fg(y - 1, x + 2)) join(block_labels[north + 1]);
+                    //a and c both touch s and t; if s is set together with
+                    //h or g, S was joined to Q or P when it was labeled
+                    if (a || c) {
+                        const bool s = fg(y, x - 1);
+                        if (s ? !(h || g) : fg(y + 1, x - 1)) join(block_labels[block - 1]);
+                    }
+                    //the first pixel of the block may come before the first
+                    //pixel known for its component, when that one is in the
+                    //bottom row of a block on the west
+                    const long first_y = a || b ? y : y + 1;
+                    const long first_x = a || (!b && c) ? x : x + 1;
+                    const uint64_t first = uint64_t(first_y) * total_columns + first_x;
+                    if (label == 0) {
+                        label = stripe->equivalences.makeSet();
+                        stripe->first_pixel.push_back(first);
+                    } else if (first < stripe->first_pixel[label]) {
+                        stripe->first_pixel[label] = first;
+                    }
+                    block_labels[block] = label;
+                }
+            }
+        }
+
+        //4-connectivity pixel by pixel; the provisional labels are kept
+        //in label_image
+        template<typename T>
+        void LabelPixels(const BinaryRows<T> &fg, long total_columns, Image *label_image, Stripe *stripe) {
+            for (long y = stripe->first_row; y < stripe->end_row; y++) {
+                int32_t *label_row = label_image->Row<int32_t>(y);
+                memset(label_row, 0, total_columns * sizeof(int32_t));
+                const int32_t *north_row = y > stripe->first_row ? label_image->Row<int32_t>(y - 1) : nullptr;
+                for (long x = 0; x < total_columns; x++) {
+                    if (!fg(y, x)) continue;
+                    const int32_t w_pxl = x > 0 ? label_row[x - 1] : 0;
+                    const int32_t n_pxl = north_row != nullptr ? north_row[x] : 0;
+                    if (n_pxl == 0 && w_pxl == 0) {
+                        label_row[x] = stripe->equivalences.makeSet();
+                        stripe->first_pixel.push_back(uint64_t(y) * total_columns + x);
+                    } else if (n_pxl == 0) {
+                        label_row[x] = w_pxl;
+                    } else if (w_pxl == 0 || fg(y - 1, x - 1)) {
+                        //a set north west pixel joined north and west already
+                        label_row[x] = n_pxl;
+                    } else {
+                        label_row[x] = stripe->equivalences.unite(n_pxl, w_pxl);
+                    }
+                }
+            }
+        }
+    }
+
+    int LabelBlockBased(const Image &binary_image, Connectivity connectivity, Image *label_image, int num_threads) {
+        if (label_image == nullptr) abort();
+        const long total_rows = binary_image.num_rows();
+        const long total_columns = binary_image.num_columns();
+        label_image->AllocateSpaceAndSetSize(total_rows, total_columns, PixelType::kInt32);
+        const bool blocks = connectivity == Connectivity::kEight;
+        const size_t block_columns = (total_columns + 1) / 2;
+        vector<uint32_t> block_labels(blocks ? ((total_rows + 1) / 2) * block_columns : 0);
+        //stripes hold whole blocks, so they are split on block rows
+        const long rows_per_unit = blocks ? 2 : 1;
+        const size_t num_units = (total_rows + rows_per_unit - 1) / rows_per_unit;
+        if (num_threads <= 0) num_threads = DefaultThreadCount();
+        vector<Stripe> stripes(num_threads);
+        int num_stripes = 0;
+        int num_labels = 0;
+
+        DispatchPixelType(binary_image.pixel_type(), [&](auto pixel) {
+            using T = decltype(pixel);
+            const BinaryRows<T> fg(binary_image);
+            //provisional label of a pixel of a stripe
+            auto provisional = [&](long y, long x) -> uint32_t {
+                return blocks ? block_labels[(y / 2) * block_columns + x / 2]
+                              : uint32_t(label_image->Row<int32_t>(y)[x]);
+            };
+
+            //first scan, every stripe on its own thread
+            num_stripes = ParallelFor(num_units, num_threads, [&](size_t begin, size_t end, int k) {
+                Stripe &stripe = stripes[k];
+                stripe.first_row = begin * rows_per_unit;
+                stripe.end_row = min<long>(total_rows, end * rows_per_unit);
+                if (blocks) LabelBlocks(fg, total_columns, block_columns, block_labels.data(), &stripe);
+                else LabelPixels(fg, total_columns, label_image, &stripe);
+                stripe.num_labels = stripe.equivalences.flatten() - 1;
+            });
+
+            //the labels of all stripes, joined along the stripe boundaries
+            int num_provisional = 0;
+            for (int k = 0; k < num_stripes; k++) {
+                stripes[k].label_offset = num_provisional;
+                num_provisional += stripes[k].num_labels;
+            }
+            DisjSets merged(num_provisional + 1);//element 0 is the background
+            auto merged_label = [&](int k, uint32_t label) {
+                return stripes[k].label_offset + stripes[k].equivalences.label(label);
+            };
+            const long first_dx = blocks ? -1 : 0, last_dx = blocks ? 1 : 0;
+            for (int k = 1; k < num_stripes; k++) {
+                const long y = stripes[k].first_row;
+                for (long x = 0; y < total_rows && x < total_columns; x++) {
+                    if (!fg(y, x)) continue;
+                    const int label = merged_label(k, provisional(y, x));
+                    for (long dx = first_dx; dx <= last_dx; dx++) {
+                        if (fg(y - 1, x + dx))
+                            merged.unite(label, merged_label(k - 1, provisional(y - 1, x + dx)));
+                    }
+                }
+            }
+
+            //final numbers in the raster order of the first pixel of each
+            //component; blocks are created in block order, which is not
+            //always the same
+            const int num_sets = merged.flatten();
+            num_labels = num_sets - 1;
+            vector<uint64_t> first_pixel(num_sets, UINT64_MAX);
+            for (int k = 0; k < num_stripes; k++) {
+                for (size_t label = 1; label < stripes[k].first_pixel.size(); label++) {
+                    uint64_t &first = first_pixel[merged.label(merged_label(k, label))];
+                    first = min(first, stripes[k].first_pixel[label]);
+                }
+            }
+            vector<int> order;
+            for (int set = 1; set < num_sets; set++) order.push_back(set);
+            sort(order.begin(), order.end(), [&](int a, int b) { return first_pixel[a] < first_pixel[b]; });
+            vector<int32_t> final_of_set(num_sets, 0);
+            for (size_t n = 0; n < order.size(); n++) final_of_set[order[n]] = int32_t(n + 1);
+            for (int k = 0; k < num_stripes; k++) {
+                Stripe &stripe = stripes[k];
+                stripe.final_labels.assign(stripe.first_pixel.size(), 0);
+                for (size_t label = 1; label < stripe.first_pixel.size(); label++)
+                    stripe.final_labels[label] = final_of_set[merged.label(merged_label(k, label))];
+            }
+
+            //second pass, every stripe on its own thread again
+            ParallelFor(num_units, num_threads, [&](size_t, size_t, int k) {
+                const Stripe &stripe = stripes[k];
+                for (long y = stripe.first_row; y < stripe.end_row; y++) {
+                    const T *row = binary_image.Row<T>(y);
+                    int32_t *label_row = label_image->Row<int32_t>(y);
+                    if (!blocks) {
+                        for (long x = 0; x < total_columns; x++)
+                            label_row[x] = row[x] == 0 ? 0 : stripe.final_labels[label_row[x]];
+                        continue;
+                    }
+                    //one lookup per block, both pixels of the row share it
+                    const uint32_t *block_row = &block_labels[(y / 2) * block_columns];
+                    long x = 0;
+                    for (; x + 1 < total_columns; x += 2) {
+                        const int32_t label = stripe.final_labels[block_row[x / 2]];
+                        label_row[x] = row[x] != 0 ? label : 0;
+                        label_row[x + 1] = row[x + 1] != 0 ? label : 0;
+                    }
+                    if (x < total_columns)
+                        label_row[x] = row[x] != 0 ? stripe.final_labels[block_row[x / 2]] : 0;
+                }
+            });
+        });
+        label_image->SetNumberGrayLevels(num_labels);
+        return num_labels;
+    }
+
+    int LabelFloodFill(const Image &binary_image, Connectivity connectivity, Image *label_image) {
+        if (label_image == nullptr) abort();
+        const long total_rows = binary_image.num_rows();
+        const long total_columns = binary_image.num_columns();
+        label_image->AllocateSpaceAndSetSize(total_rows, total_columns, PixelType::kInt32);
+        for (long y = 0; y < total_rows; y++)
+            memset(label_image->Row<int32_t>(y), 0, total_columns * sizeof(int32_t));
+        const int num_neighbors = connectivity == Connectivity::kEight ? 8 : 4;
+        const long dy[] = {-1, 0, 0, 1, -1, -1, 1, 1};
+        const long dx[] = {0, -1, 1, 0, -1, 1, -1, 1};
+        int num_labels = 0;
+        DispatchPixelType(binary_image.pixel_type(), [&](auto pixel) {
+            using T = decltype(pixel);
+            const BinaryRows<T> fg(binary_image);
+            vector<pair<long, long>> pending;
+            for (long y = 0; y < total_rows; y++) {
+                for (long x = 0; x < total_columns; x++) {
+                    if (!fg(y, x) || label_image->Row<int32_t>(y)[x] != 0) continue;
+                    //new component, fill it
+                    ++num_labels;
+                    label_image->Row<int32_t>(y)[x] = num_labels;
+                    pending.emplace_back(y, x);
+                    while (!pending.empty()) {
+                        const long py = pending.back().first, px = pending.back().second;
+                        pending.pop_back();
+                        for (int n = 0; n < num_neighbors; n++) {
+                            const long ny = py + dy[n], nx = px + dx[n];
+                            if (!fg(ny, nx)) continue;
+                            int32_t &label = label_image->Row<int32_t>(ny)[nx];
+                            if (label != 0) continue;
+                            label = num_labels;
+                            pending.emplace_back(ny, nx);
+                        }
+                    }
+                }
+            }
+        });
+        label_image->SetNumberGrayLevels(num_labels);
+        return num_labels;
+    }
+
+    void RenderLabels(const Image &label_image, Image *an_image) {
+        if (an_image == nullptr) abort();
+        const size_t total_rows = label_image.num_rows();
+        const size_t total_columns = label_image.num_columns();
+        an_image->AllocateSpaceAndSetSize(total_rows, total_columns);
+        an_image->SetNumberGrayLevels(255);
+        for (size_t y = 0; y < total_rows; y++) {
+            const int32_t *label_row = label_image.Row<int32_t>(y);
+            uint8_t *row = an_image->Row<uint8_t>(y);
+            for (size_t x = 0; x < total_columns; x++)
+                row[x] = label_row[x] == 0 ? 0 : static_cast<uint8_t>(25 + 40 * (label_row[x] - 1));
+        }
+    }
+}  // namespace ComputerVisionProjects
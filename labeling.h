@@ -0,0 +1,111 @@
+// Connected-component labeling engines for binary images.
+// To be used in Computer Vision class.
+//
+// labeling.h
+// Alternatives to the pixel-by-pixel LabelBinarySequentially(),
+// selectable from p2. Every engine numbers the components 1..N in the
+// raster order of their first pixel, so their results can be
+// compared directly with each other.
+
+#ifndef COMPUTER_VISION_LABELING_H_
+#define COMPUTER_VISION_LABELING_H_
+
+#include "image.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace ComputerVisionProjects {
+
+// A horizontal run of foreground pixels: columns first..last
+// (inclusive) of row, belonging to component label.
+struct Run {
+  uint32_t row;
+  uint32_t first;
+  uint32_t last;
+  uint32_t label;
+};
+
+// Run-length encoded labeled image.
+struct RunLengthLabels {
+  size_t num_rows = 0;
+  size_t num_columns = 0;
+  // All the runs in raster order.
+  std::vector<Run> runs;
+  // The runs of row i are runs[row_starts[i]] .. runs[row_starts[i + 1] - 1];
+  // row_starts has num_rows + 1 entries.
+  std::vector<size_t> row_starts;
+  // Components are labeled 1..num_labels.
+  int num_labels = 0;
+};
+
+// Appends the runs of the pixels of row y for which
+// is_foreground(pixel) is true to runs, with label 0.
+template <typename T, typename IsForeground>
+void AppendRuns(const T *row, size_t num_columns, uint32_t y,
+                IsForeground is_foreground, std::vector<Run> *runs) {
+  size_t x = 0;
+  while (x < num_columns) {
+    while (x < num_columns && !is_foreground(row[x])) ++x;
+    if (x == num_columns) break;
+    const size_t first = x;
+    while (x < num_columns && is_foreground(row[x])) ++x;
+    runs->push_back({y, uint32_t(first), uint32_t(x - 1), 0});
+  }
+}
+
+// Same for the pixels >= treshold of an 8-bit row, which is packed
+// into bits first so runs are found a 64-bit word at a time. bits
+// must hold (num_columns + 63) / 64 words.
+void AppendThresholdedRuns(const uint8_t *row, size_t num_columns,
+                           uint32_t y, int treshold,
+                           std::vector<uint64_t> *bits,
+                           std::vector<Run> *runs);
+
+// Labels a binary image (nonzero pixels are foreground) by encoding
+// each row as runs and merging the runs that touch a run of the row
+// above. With 8-connectivity a run also touches the runs that end
+// right before it or start right after it (north west and north
+// east). Only runs are visited, never background pixels one by one.
+void LabelRunLength(const Image &binary_image, RunLengthLabels *labels,
+                    Connectivity connectivity = Connectivity::kEight);
+
+// Draws the runs into an_image, which is resized to their size,
+// with the gray levels LabelBinarySequentially() gives each label.
+void RenderLabels(const RunLengthLabels &labels, Image *an_image);
+
+// Labels a binary image into label_image, resized to its size with
+// PixelType::kInt32 pixels: 0 for the background, 1..N for the
+// components. Returns N.
+//
+// With 8-connectivity the image is scanned in 2x2 blocks, all of
+// whose foreground pixels are connected, and a block is joined to
+// its west, north west, north and north east blocks following a
+// decision tree (Grana et al., "Optimized Block-based Connected
+// Components Labeling with Decision Trees", 2010): each neighbor
+// pixel is read at most once, and neighbors that are already known
+// to be equivalent are not united again. With 4-connectivity the
+// same is done pixel by pixel on the north and west neighbors.
+//
+// The image is split into num_threads horizontal stripes (0 means
+// one per hardware thread), labeled in parallel with labels local to
+// each stripe. Their equivalences are then joined along the stripe
+// boundaries and the stripes are relabeled in parallel; the result
+// does not depend on the number of threads.
+int LabelBlockBased(const Image &binary_image, Connectivity connectivity,
+                    Image *label_image, int num_threads = 1);
+
+// Reference labeling by flood fill from the first pixel of each
+// component, with the same output as LabelBlockBased(). Slow, meant
+// to verify the other engines.
+int LabelFloodFill(const Image &binary_image, Connectivity connectivity,
+                   Image *label_image);
+
+// Draws a label image of LabelBlockBased() or LabelFloodFill() into
+// an_image with the gray levels LabelBinarySequentially() gives
+// each label.
+void RenderLabels(const Image &label_image, Image *an_image);
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_LABELING_H_
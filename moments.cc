@@ -0,0 +1,283 @@
+//
+// moments.cc
+// Raw moment accumulation over label images and runs.
+//
+
+#include "moments.h"
+#include "labeling.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cstdlib>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace ComputerVisionProjects {
+
+    namespace {
+        //number of pixels, sum of j and sum of j^2 of a run of columns
+        struct RunSums {
+            int64_t n;
+            int64_t sum_j;
+            int64_t sum_jj;
+        };
+
+        //closed form sums over j = first..last, so a run costs O(1). The
+        //cubes are formed in 128 bits; the results fit in 64 bits within
+        //kMaxMomentCoordinate
+        RunSums SumRun(int64_t first, int64_t last) {
+            const int64_t n = last - first + 1;
+            //sum of j^2 for j = 0..k is k(k+1)(2k+1)/6
+            auto sum_of_squares = [](__int128 k) { return k * (k + 1) * (2 * k + 1) / 6; };
+            return {n, (first + last) * n / 2, int64_t(sum_of_squares(last) - sum_of_squares(first - 1))};
+        }
+    }
+
+    void ComponentMoments::AddRun(long long i, long long first, long long last) {
+        const RunSums run = SumRun(first, last);
+        area += run.n;
+        sum_i += i * run.n;
+        sum_j += run.sum_j;
+        sum_ii += i * i * run.n;
+        sum_ij += i * run.sum_j;
+        sum_jj += run.sum_jj;
+        min_i = min(min_i, i);
+        max_i = max(max_i, i);
+        min_j = min(min_j, first);
+        max_j = max(max_j, last);
+    }
+
+    void ComponentMoments::Add(const ComponentMoments &other) {
+        area += other.area;
+        sum_i += other.sum_i;
+        sum_j += other.sum_j;
+        sum_ii += other.sum_ii;
+        sum_ij += other.sum_ij;
+        sum_jj += other.sum_jj;
+        min_i = min(min_i, other.min_i);
+        max_i = max(max_i, other.max_i);
+        min_j = min(min_j, other.min_j);
+        max_j = max(max_j, other.max_j);
+    }
+
+    void MomentSums::Reset(int num_labels) {
+        const size_t size = num_labels + 1;
+        area.assign(size, 0);
+        sum_i.assign(size, 0);
+        sum_j.assign(size, 0);
+        sum_ii.assign(size, 0);
+        sum_ij.assign(size, 0);
+        sum_jj.assign(size, 0);
+        min_i.assign(size, INT64_MAX);
+        max_i.assign(size, -1);
+        min_j.assign(size, INT64_MAX);
+        max_j.assign(size, -1);
+    }
+
+    void MomentSums::Resize(int num_labels) {
+        const size_t size = max<size_t>(num_labels + 1, area.size());
+        area.resize(size, 0);
+        sum_i.resize(size, 0);
+        sum_j.resize(size, 0);
+        sum_ii.resize(size, 0);
+        sum_ij.resize(size, 0);
+        sum_jj.resize(size, 0);
+        min_i.resize(size, INT64_MAX);
+        max_i.resize(size, -1);
+        min_j.resize(size, INT64_MAX);
+        max_j.resize(size, -1);
+    }
+
+    void MomentSums::Clear(int label) {
+        area[label] = 0;
+        sum_i[label] = 0;
+        sum_j[label] = 0;
+        sum_ii[label] = 0;
+        sum_ij[label] = 0;
+        sum_jj[label] = 0;
+        min_i[label] = INT64_MAX;
+        max_i[label] = -1;
+        min_j[label] = INT64_MAX;
+        max_j[label] = -1;
+    }
+
+    void MomentSums::AddRun(int label, int64_t i, int64_t first, int64_t last) {
+        const RunSums run = SumRun(first, last);
+        area[label] += run.n;
+        sum_i[label] += i * run.n;
+        sum_j[label] += run.sum_j;
+        sum_ii[label] += i * i * run.n;
+        sum_ij[label] += i * run.sum_j;
+        sum_jj[label] += run.sum_jj;
+        min_i[label] = min(min_i[label], i);
+        max_i[label] = max(max_i[label], i);
+        min_j[label] = min(min_j[label], first);
+        max_j[label] = max(max_j[label], last);
+    }
+
+    void MomentSums::Add(const MomentSums &other) {
+        Add(other, 0, area.size());
+    }
+
+    void MomentSums::Add(const MomentSums &other, size_t begin, size_t end) {
+        //independent streams the compiler vectorizes
+        for (size_t k = begin; k < end; ++k) {
+            area[k] += other.area[k];
+            sum_i[k] += other.sum_i[k];
+            sum_j[k] += other.sum_j[k];
+            sum_ii[k] += other.sum_ii[k];
+            sum_ij[k] += other.sum_ij[k];
+            sum_jj[k] += other.sum_jj[k];
+        }
+        for (size_t k = begin; k < end; ++k) {
+            min_i[k] = min(min_i[k], other.min_i[k]);
+            max_i[k] = max(max_i[k], other.max_i[k]);
+            min_j[k] = min(min_j[k], other.min_j[k]);
+            max_j[k] = max(max_j[k], other.max_j[k]);
+        }
+    }
+
+    ComponentMoments MomentSums::Get(int label) const {
+        ComponentMoments moments;
+        moments.area = area[label];
+        moments.sum_i = sum_i[label];
+        moments.sum_j = sum_j[label];
+        moments.sum_ii = sum_ii[label];
+        moments.sum_ij = sum_ij[label];
+        moments.sum_jj = sum_jj[label];
+        moments.min_i = min_i[label];
+        moments.max_i = max_i[label];
+        moments.min_j = min_j[label];
+        moments.max_j = max_j[label];
+        return moments;
+    }
+
+    namespace {
+        //first column at or after j whose label differs from row[j]
+        template<typename T>
+        size_t RunEnd(const T *row, size_t j, size_t num_columns) {
+            const T label = row[j];
+            while (j < num_columns && row[j] == label) ++j;
+            return j;
+        }
+
+#if defined(__SSE2__)
+        //label images and 8-bit images compare a whole vector of pixels
+        //against the label of the run at a time
+        size_t RunEnd(const int32_t *row, size_t j, size_t num_columns) {
+            const int32_t label = row[j];
+            const __m128i l = _mm_set1_epi32(label);
+            for (; j + 4 <= num_columns; j += 4) {
+                const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + j));
+                const int equal = _mm_movemask_epi8(_mm_cmpeq_epi32(v, l));
+                if (equal != 0xFFFF) return j + __builtin_ctz(~equal & 0xFFFF) / 4;
+            }
+            while (j < num_columns && row[j] == label) ++j;
+            return j;
+        }
+
+        size_t RunEnd(const uint8_t *row, size_t j, size_t num_columns) {
+            const uint8_t label = row[j];
+            const __m128i l = _mm_set1_epi8(static_cast<char>(label));
+            for (; j + 16 <= num_columns; j += 16) {
+                const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + j));
+                const int equal = _mm_movemask_epi8(_mm_cmpeq_epi8(v, l));
+                if (equal != 0xFFFF) return j + __builtin_ctz(~equal & 0xFFFF);
+            }
+            while (j < num_columns && row[j] == label) ++j;
+            return j;
+        }
+#endif
+
+        template<typename T>
+        void AccumulateRows(const Image &label_image, size_t first_row, size_t end_row, int num_labels,
+                            MomentSums *sums) {
+            const size_t total_columns = label_image.num_columns();
+            for (size_t i = first_row; i < end_row; ++i) {
+                const T *row = label_image.Row<T>(i);
+                size_t j = 0;
+                while (j < total_columns) {
+                    const size_t end = RunEnd(row, j, total_columns);
+                    const int64_t label = row[j];
+                    if (label > 0 && label <= num_labels) sums->AddRun(int(label), i, j, end - 1);
+                    j = end;
+                }
+            }
+        }
+    }
+
+    void AccumulateMoments(const Image &label_image, int num_labels, MomentSums *sums, int num_threads) {
+        if (sums == nullptr) abort();
+        sums->Reset(num_labels);
+        if (num_threads <= 0) num_threads = DefaultThreadCount();
+        //every band but the first has its own copy of the sums
+        const size_t sums_bytes = size_t(num_labels + 1) * 10 * sizeof(int64_t);
+        const size_t image_bytes = label_image.num_rows() * label_image.num_columns() * label_image.bytes_per_pixel();
+        num_threads = int(min<size_t>(num_threads, 1 + image_bytes / sums_bytes));
+        vector<MomentSums> bands(num_threads > 1 ? num_threads - 1 : 0);
+
+        int num_bands = 0;
+        DispatchPixelType(label_image.pixel_type(), [&](auto pixel) {
+            using T = decltype(pixel);
+            num_bands = ParallelFor(label_image.num_rows(), num_threads, [&](size_t begin, size_t end, int k) {
+                MomentSums *band = sums;
+                if (k > 0) {
+                    band = &bands[k - 1];
+                    band->Reset(num_labels);
+                }
+                AccumulateRows<T>(label_image, begin, end, num_labels, band);
+            });
+        });
+        if (num_bands <= 1) return;
+        //the bands are added in order, every thread a range of labels
+        ParallelFor(sums->area.size(), num_threads, [&](size_t begin, size_t end, int) {
+            for (int k = 1; k < num_bands; ++k) sums->Add(bands[k - 1], begin, end);
+        });
+    }
+
+    void AccumulateMoments(const Image &labeled_image, MomentSums *sums, int num_threads) {
+        //the largest gray level, one per band first
+        if (num_threads <= 0) num_threads = DefaultThreadCount();
+        vector<int64_t> band_max(num_threads, 0);
+        DispatchPixelType(labeled_image.pixel_type(), [&](auto pixel) {
+            using T = decltype(pixel);
+            ParallelFor(labeled_image.num_rows(), num_threads, [&](size_t begin, size_t end, int k) {
+                int64_t max_label = 0;
+                for (size_t i = begin; i < end; ++i) {
+                    const T *row = labeled_image.Row<T>(i);
+                    for (size_t j = 0; j < labeled_image.num_columns(); ++j)
+                        max_label = max<int64_t>(max_label, row[j]);
+                }
+                band_max[k] = max_label;
+            });
+        });
+        const int64_t max_label = *max_element(band_max.begin(), band_max.end());
+        AccumulateMoments(labeled_image, int(max_label), sums, num_threads);
+    }
+
+    void AccumulateMoments(const RunLengthLabels &labels, MomentSums *sums) {
+        if (sums == nullptr) abort();
+        sums->Reset(labels.num_labels);
+        for (const Run &run: labels.runs) sums->AddRun(run.label, run.row, run.first, run.last);
+    }
+
+    void AccumulateMoments(const vector<ComponentMoments> &components, MomentSums *sums) {
+        if (sums == nullptr) abort();
+        sums->Reset(int(components.size()));
+        for (size_t k = 0; k < components.size(); ++k) {
+            sums->area[k + 1] = components[k].area;
+            sums->sum_i[k + 1] = components[k].sum_i;
+            sums->sum_j[k + 1] = components[k].sum_j;
+            sums->sum_ii[k + 1] = components[k].sum_ii;
+            sums->sum_ij[k + 1] = components[k].sum_ij;
+            sums->sum_jj[k + 1] = components[k].sum_jj;
+            sums->min_i[k + 1] = components[k].min_i;
+            sums->max_i[k + 1] = components[k].max_i;
+            sums->min_j[k + 1] = components[k].min_j;
+            sums->max_j[k + 1] = components[k].max_j;
+        }
+    }
+}  // namespace ComputerVisionProjects
@@ -0,0 +1,114 @@
+// Raw moments of the objects of a labeled image.
+// To be used in Computer Vision class.
+//
+// moments.h
+// The sums MakeDataset() and CheckObjectFromDatabase() derive the
+// center, orientation and roundedness of every object from. They are
+// exact 64-bit integers and are kept as a struct of arrays indexed
+// by label, so accumulating them needs no hashing, and a run of
+// pixels of one label in a row is added in closed form.
+
+#ifndef COMPUTER_VISION_MOMENTS_H_
+#define COMPUTER_VISION_MOMENTS_H_
+
+#include "image.h"
+
+#include <climits>
+#include <cstdint>
+#include <vector>
+
+namespace ComputerVisionProjects {
+
+struct RunLengthLabels;
+
+// The moments are exact 64-bit integer sums. They cannot overflow
+// as long as every row and column index is below this: even a
+// component covering a whole 65536 x 65536 image has sums of i^2
+// and j^2 of 65536^4 / 3 < 2^63. Images with more rows or columns
+// may overflow the sums of large components.
+const int64_t kMaxMomentCoordinate = 65536;
+
+// Raw moments of a connected component. i is the row and j the
+// column of a pixel, the same convention MakeDataset() uses.
+struct ComponentMoments {
+  long long area = 0;
+  long long sum_i = 0;
+  long long sum_j = 0;
+  long long sum_ii = 0;
+  long long sum_ij = 0;
+  long long sum_jj = 0;
+  // Bounding box; min > max while the component is empty.
+  long long min_i = LLONG_MAX;
+  long long max_i = -1;
+  long long min_j = LLONG_MAX;
+  long long max_j = -1;
+
+  // Adds the pixels of row i from column first to column last.
+  void AddRun(long long i, long long first, long long last);
+  void Add(const ComponentMoments &other);
+};
+
+// Raw moments of labels 1..num_labels(). Entry k of every array
+// belongs to label k; entry 0 is the background and stays 0.
+struct MomentSums {
+  std::vector<int64_t> area;
+  std::vector<int64_t> sum_i;
+  std::vector<int64_t> sum_j;
+  std::vector<int64_t> sum_ii;
+  std::vector<int64_t> sum_ij;
+  std::vector<int64_t> sum_jj;
+  // Bounding box of every label; min > max for labels with no pixels.
+  std::vector<int64_t> min_i;
+  std::vector<int64_t> max_i;
+  std::vector<int64_t> min_j;
+  std::vector<int64_t> max_j;
+
+  // Sets all the sums of labels 1..num_labels to 0 and their
+  // bounding boxes to empty.
+  void Reset(int num_labels);
+  // Adds empty labels up to num_labels, keeping the sums of the
+  // labels there already.
+  void Resize(int num_labels);
+  // Empties one label.
+  void Clear(int label);
+  int num_labels() const { return static_cast<int>(area.size()) - 1; }
+
+  // Adds the pixels of row i from column first to column last to
+  // label, in closed form.
+  void AddRun(int label, int64_t i, int64_t first, int64_t last);
+  // Adds all the sums of other, which has the same number of labels.
+  void Add(const MomentSums &other);
+  // Same for labels begin..end - 1 only.
+  void Add(const MomentSums &other, size_t begin, size_t end);
+  ComponentMoments Get(int label) const;
+};
+
+// Accumulates the moments of labels 1..num_labels of label_image;
+// pixels <= 0 or > num_labels are ignored. Consecutive pixels of the
+// same label are added as one run.
+//
+// The rows are split into num_threads bands (0 means one per hardware
+// thread), each accumulated into its own MomentSums, which are then
+// added up, every thread a range of labels. The sums are integers, so
+// the result does not depend on the number of threads. Fewer threads
+// are used when their copies of the sums would take more memory than
+// the image.
+void AccumulateMoments(const Image &label_image, int num_labels,
+                       MomentSums *sums, int num_threads = 1);
+
+// Same, with one label per gray level up to the largest one in the
+// image, for images labeled by LabelBinarySequentially() in place.
+void AccumulateMoments(const Image &labeled_image, MomentSums *sums,
+                       int num_threads = 1);
+
+// Same from the runs of LabelRunLength().
+void AccumulateMoments(const RunLengthLabels &labels, MomentSums *sums);
+
+// Same from components measured while they were labeled (see
+// LabelThresholded()), numbered 1..N in the order given.
+void AccumulateMoments(const std::vector<ComponentMoments> &components,
+                       MomentSums *sums);
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_MOMENTS_H_
@@ -0,0 +1,417 @@
+//
+// object_database.cc
+// Text and binary object databases.
+//
+
+#include "object_database.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace ComputerVisionProjects {
+
+    namespace {
+        const char kObjectDatabaseMagic[8] = {'C', 'V', 'O', 'B', 'J', 'D', 'B', '\0'};
+        //segment files end in this; temporary files never do
+        const char kSegmentSuffix[] = ".seg";
+        const size_t kSegmentSuffixLength = sizeof(kSegmentSuffix) - 1;
+
+        //unique per process and per call
+        string TemporaryPath(const string &file_path) {
+            static atomic<unsigned> counter{0};
+            return file_path + ".tmp." + to_string(getpid()) + "." + to_string(counter++);
+        }
+
+        //the contents of a text or binary database
+        string EncodeRecords(const vector<ObjectRecord> &records, bool text) {
+            if (text) {
+                //the same fields MakeDataset() writes, the same way
+                ostringstream out_stream;
+                for (const ObjectRecord &record: records) {
+                    out_stream << record.id << " " << record.center_row << " " << record.center_column << " "
+                               << record.min_moment << " " << int64_t(record.area) << " "
+                               << float(record.roundedness) << " " << record.orientation << " " << "\n\n";
+                }
+                return out_stream.str();
+            }
+            ObjectDatabaseHeader header;
+            memcpy(header.magic, kObjectDatabaseMagic, sizeof(header.magic));
+            header.version = kObjectDatabaseVersion;
+            header.header_size = sizeof(ObjectDatabaseHeader);
+            header.record_size = sizeof(ObjectRecord);
+            header.fields = kAllObjectFields;
+            header.num_records = records.size();
+            string bytes(sizeof(header) + records.size() * sizeof(ObjectRecord), '\0');
+            memcpy(&bytes[0], &header, sizeof(header));
+            if (!records.empty()) memcpy(&bytes[sizeof(header)], records.data(), records.size() * sizeof(ObjectRecord));
+            return bytes;
+        }
+
+        //writes bytes to file_path and waits until they are on the disk
+        bool WriteFileSynced(const string &file_path, const string &bytes) {
+            FILE *output = fopen(file_path.c_str(), "wb");
+            if (output == nullptr) return false;
+            bool complete = fwrite(bytes.data(), 1, bytes.size(), output) == bytes.size();
+            complete = fflush(output) == 0 && fsync(fileno(output)) == 0 && complete;
+            complete = fclose(output) == 0 && complete;
+            if (!complete) remove(file_path.c_str());
+            return complete;
+        }
+
+        //written next to file_path and renamed over it, so a process
+        //that has the old file mapped keeps reading a complete file
+        bool ReplaceFile(const string &file_path, const string &bytes) {
+            const string temporary_path = TemporaryPath(file_path);
+            if (!WriteFileSynced(temporary_path, bytes)) return false;
+            if (rename(temporary_path.c_str(), file_path.c_str()) != 0) {
+                remove(temporary_path.c_str());
+                return false;
+            }
+            return true;
+        }
+    }
+
+    bool ReadTextObjectDatabase(const string &database_file_path, vector<ObjectRecord> *records) {
+        if (records == nullptr) abort();
+        ifstream in_stream(database_file_path);
+        if (!in_stream) return false;
+        records->clear();
+        string db_line;
+        while (getline(in_stream, db_line)) {
+            double fields[7] = {0, 0, 0, 0, 0, 0, 0};
+            const char *position = db_line.c_str();
+            int num_fields = 0;
+            while (num_fields < 7) {
+                char *field_end = nullptr;
+                const double value = strtod(position, &field_end);
+                if (field_end == position) break;
+                fields[num_fields++] = value;
+                position = field_end;
+            }
+            if (num_fields == 0) continue;
+            ObjectRecord record;
+            record.id = int32_t(fields[0]);
+            record.center_row = int32_t(fields[1]);
+            record.center_column = int32_t(fields[2]);
+            record.min_moment = fields[3];
+            record.area = fields[4];
+            record.roundedness = fields[5];
+            record.orientation = fields[6];
+            records->push_back(record);
+        }
+        return true;
+    }
+
+    bool WriteBinaryObjectDatabase(const string &database_file_path, const vector<ObjectRecord> &records) {
+        if (!ReplaceFile(database_file_path, EncodeRecords(records, false))) {
+            cout << "WriteBinaryObjectDatabase: Cannot write file " << database_file_path << endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool WriteTextObjectDatabase(const string &database_file_path, const vector<ObjectRecord> &records) {
+        if (!ReplaceFile(database_file_path, EncodeRecords(records, true))) {
+            cout << "WriteTextObjectDatabase: Cannot write file " << database_file_path << endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool ConvertObjectDatabase(const string &text_file_path, const string &binary_file_path) {
+        vector<ObjectRecord> records;
+        if (!ReadTextObjectDatabase(text_file_path, &records)) {
+            cout << "ConvertObjectDatabase: Cannot open file " << text_file_path << endl;
+            return false;
+        }
+        return WriteBinaryObjectDatabase(binary_file_path, records);
+    }
+
+    bool ObjectDatabase::Open(const string &database_file_path) {
+        records_ = nullptr;
+        num_records_ = 0;
+        parsed_.clear();
+        mapping_.reset();
+
+        FILE *input = fopen(database_file_path.c_str(), "rb");
+        if (input == nullptr) return false;
+        char magic[sizeof(kObjectDatabaseMagic)];
+        const bool binary = fread(magic, sizeof(magic), 1, input) == 1 &&
+                            memcmp(magic, kObjectDatabaseMagic, sizeof(magic)) == 0;
+        fclose(input);
+        if (binary) return OpenBinary(database_file_path);
+
+        if (!ReadTextObjectDatabase(database_file_path, &parsed_)) return false;
+        records_ = parsed_.data();
+        num_records_ = parsed_.size();
+        return true;
+    }
+
+    bool ObjectDatabase::OpenBinary(const string &database_file_path) {
+        const int fd = open(database_file_path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) != 0 || size_t(file_stat.st_size) < sizeof(ObjectDatabaseHeader)) {
+            close(fd);
+            return false;
+        }
+        const size_t file_size = static_cast<size_t>(file_stat.st_size);
+        void *mapped = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        //the mapping keeps its own reference to the file
+        close(fd);
+        if (mapped == MAP_FAILED) return false;
+        shared_ptr<const void> mapping(mapped, [file_size](const void *address) {
+            munmap(const_cast<void *>(address), file_size);
+        });
+
+        ObjectDatabaseHeader header;
+        memcpy(&header, mapped, sizeof(header));
+        const uint32_t needed_fields = kFieldId | kFieldArea | kFieldRoundedness;
+        if (header.version != kObjectDatabaseVersion || header.header_size < sizeof(header) ||
+            header.header_size % alignof(ObjectRecord) != 0 || header.record_size != sizeof(ObjectRecord) ||
+            (header.fields & needed_fields) != needed_fields) {
+            cout << "ObjectDatabase: unsupported database " << database_file_path << endl;
+            return false;
+        }
+        if (header.header_size > file_size ||
+            (file_size - header.header_size) / sizeof(ObjectRecord) < header.num_records) {
+            cout << "ObjectDatabase: short file " << database_file_path << endl;
+            return false;
+        }
+        records_ = reinterpret_cast<const ObjectRecord *>(static_cast<const char *>(mapped) + header.header_size);
+        num_records_ = header.num_records;
+        mapping_ = std::move(mapping);
+        return true;
+    }
+
+    shared_ptr<const ObjectDatabase> LoadObjectDatabase(const string &database_file_path) {
+        //databases by path, with the file attributes they were loaded with
+        struct CachedDatabase {
+            off_t size;
+            struct timespec modified;
+            ino_t inode;
+            shared_ptr<const ObjectDatabase> database;
+        };
+        static mutex cache_mutex;
+        static map<string, CachedDatabase> cache;
+
+        struct stat file_stat;
+        if (stat(database_file_path.c_str(), &file_stat) != 0) return nullptr;
+        lock_guard<mutex> lock(cache_mutex);
+        auto cached = cache.find(database_file_path);
+        if (cached != cache.end() && cached->second.size == file_stat.st_size &&
+            cached->second.inode == file_stat.st_ino &&
+            cached->second.modified.tv_sec == file_stat.st_mtim.tv_sec &&
+            cached->second.modified.tv_nsec == file_stat.st_mtim.tv_nsec) {
+            return cached->second.database;
+        }
+        auto database = make_shared<ObjectDatabase>();
+        if (!database->Open(database_file_path)) return nullptr;
+        cache[database_file_path] = {file_stat.st_size, file_stat.st_mtim, file_stat.st_ino, database};
+        return database;
+    }
+
+    namespace {
+        string SegmentDirectory(const string &database_file_path) {
+            return database_file_path + ".segments";
+        }
+
+        string JournalPath(const string &database_file_path) {
+            return SegmentDirectory(database_file_path) + "/compaction";
+        }
+
+        //names of the segment files, oldest first
+        vector<string> ListSegments(const string &directory) {
+            vector<string> segments;
+            DIR *entries = opendir(directory.c_str());
+            if (entries == nullptr) return segments;
+            while (const struct dirent *entry = readdir(entries)) {
+                const string name(entry->d_name);
+                if (name.size() > kSegmentSuffixLength &&
+                    name.compare(name.size() - kSegmentSuffixLength, kSegmentSuffixLength, kSegmentSuffix) == 0)
+                    segments.push_back(name);
+            }
+            closedir(entries);
+            sort(segments.begin(), segments.end());
+            return segments;
+        }
+
+        //completes or undoes a compaction that stopped after writing its
+        //journal. The journal holds the temporary file of the new
+        //database, its inode and the segments merged into it: if the
+        //database has that inode it was replaced and the segments are
+        //deleted, otherwise the new database is
+        void FinishCompaction(const string &database_file_path) {
+            const string journal_path = JournalPath(database_file_path);
+            ifstream journal(journal_path);
+            if (!journal) return;
+            string temporary_path;
+            string inode;
+            getline(journal, temporary_path);
+            getline(journal, inode);
+            struct stat file_stat;
+            if (!inode.empty() && stat(database_file_path.c_str(), &file_stat) == 0 &&
+                file_stat.st_ino == ino_t(stoull(inode))) {
+                string name;
+                while (getline(journal, name))
+                    if (!name.empty()) remove((SegmentDirectory(database_file_path) + "/" + name).c_str());
+            } else {
+                remove(temporary_path.c_str());
+            }
+            journal.close();
+            remove(journal_path.c_str());
+        }
+
+        //makes the entries renamed into or deleted from directory durable
+        bool SyncDirectory(const string &directory) {
+            const int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+            if (fd < 0) return false;
+            const bool synced = fsync(fd) == 0;
+            close(fd);
+            return synced;
+        }
+
+        //takes the lock that serializes the writers of a database and
+        //returns the file that holds it, to be closed to release it, or -1
+        int LockDatabase(const string &database_file_path, const char *caller) {
+            const string lock_path = database_file_path + ".lock";
+            const int lock = open(lock_path.c_str(), O_RDWR | O_CREAT, 0644);
+            if (lock < 0) {
+                cout << caller << ": Cannot open file " << lock_path << endl;
+                return -1;
+            }
+            if (flock(lock, LOCK_EX) != 0) {
+                close(lock);
+                return -1;
+            }
+            return lock;
+        }
+
+        int CompactLocked(const string &database_file_path) {
+            FinishCompaction(database_file_path);
+            const string directory = SegmentDirectory(database_file_path);
+            const vector<string> segments = ListSegments(directory);
+            if (segments.empty()) return 0;
+
+            vector<ObjectRecord> records;
+            bool text = database_file_path.size() >= 4 &&
+                        database_file_path.compare(database_file_path.size() - 4, 4, ".txt") == 0;
+            struct stat file_stat;
+            if (stat(database_file_path.c_str(), &file_stat) == 0) {
+                ObjectDatabase database;
+                if (!database.Open(database_file_path)) {
+                    cout << "CompactObjectDatabase: Cannot open file " << database_file_path << endl;
+                    return -1;
+                }
+                text = !database.is_mapped();
+                records.assign(database.begin(), database.end());
+            }
+            int32_t next_id = 1;
+            for (const ObjectRecord &record: records) next_id = max(next_id, record.id + 1);
+            for (const string &name: segments) {
+                ObjectDatabase segment;
+                if (!segment.Open(directory + "/" + name) || !segment.is_mapped()) {
+                    cout << "CompactObjectDatabase: Cannot open segment " << name << endl;
+                    return -1;
+                }
+                for (ObjectRecord record: segment) {
+                    record.id = next_id++;
+                    records.push_back(record);
+                }
+            }
+
+            //the new database is written, then the journal, and only then
+            //is the database replaced
+            const string temporary_path = TemporaryPath(database_file_path);
+            struct stat temporary_stat;
+            if (!WriteFileSynced(temporary_path, EncodeRecords(records, text)) ||
+                stat(temporary_path.c_str(), &temporary_stat) != 0) {
+                cout << "CompactObjectDatabase: Cannot write file " << database_file_path << endl;
+                remove(temporary_path.c_str());
+                return -1;
+            }
+            ostringstream journal;
+            journal << temporary_path << "\n" << temporary_stat.st_ino << "\n";
+            for (const string &name: segments) journal << name << "\n";
+            //the journal has to be on the disk before the database is
+            //replaced, or a crash could keep the new database and lose the
+            //list of the segments already merged into it
+            if (!ReplaceFile(JournalPath(database_file_path), journal.str()) || !SyncDirectory(directory)) {
+                cout << "CompactObjectDatabase: Cannot write the journal" << endl;
+                remove(temporary_path.c_str());
+                return -1;
+            }
+            const bool replaced = rename(temporary_path.c_str(), database_file_path.c_str()) == 0;
+            FinishCompaction(database_file_path);
+            if (!replaced) {
+                cout << "CompactObjectDatabase: Cannot replace file " << database_file_path << endl;
+                return -1;
+            }
+            return int(segments.size());
+        }
+    }
+
+    bool AppendObjectDatabaseSegment(const string &database_file_path, const vector<ObjectRecord> &records) {
+        const string directory = SegmentDirectory(database_file_path);
+        if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+            cout << "AppendObjectDatabaseSegment: Cannot create directory " << directory << endl;
+            return false;
+        }
+        //names sort in the order the segments were started
+        static atomic<unsigned> counter{0};
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        char name[80];
+        snprintf(name, sizeof(name), "%020lld-%010d-%010u%s", (long long)now.tv_sec * 1000000000LL + now.tv_nsec,
+                 int(getpid()), counter++, kSegmentSuffix);
+        if (!ReplaceFile(directory + "/" + name, EncodeRecords(records, false))) {
+            cout << "AppendObjectDatabaseSegment: Cannot write segment " << name << endl;
+            return false;
+        }
+        return true;
+    }
+
+    int CompactObjectDatabase(const string &database_file_path) {
+        const int lock = LockDatabase(database_file_path, "CompactObjectDatabase");
+        if (lock < 0) return -1;
+        const int merged = CompactLocked(database_file_path);
+        //closing the file releases the lock
+        close(lock);
+        return merged;
+    }
+
+    bool ReplaceObjectDatabase(const string &database_file_path, const vector<ObjectRecord> &records, bool text) {
+        const int lock = LockDatabase(database_file_path, "ReplaceObjectDatabase");
+        if (lock < 0) return false;
+        FinishCompaction(database_file_path);
+        //the pending segments were appended to the database being replaced;
+        //they go first, so a crash cannot leave them to be merged into the
+        //new one
+        const string directory = SegmentDirectory(database_file_path);
+        const vector<string> segments = ListSegments(directory);
+        for (const string &name: segments) remove((directory + "/" + name).c_str());
+        bool replaced = segments.empty() || SyncDirectory(directory);
+        replaced = replaced && ReplaceFile(database_file_path, EncodeRecords(records, text));
+        if (!replaced) cout << "ReplaceObjectDatabase: Cannot write file " << database_file_path << endl;
+        //closing the file releases the lock
+        close(lock);
+        return replaced;
+    }
+}  // namespace ComputerVisionProjects
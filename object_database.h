@@ -0,0 +1,165 @@
+// Database of known objects.
+// To be used in Computer Vision class.
+//
+// object_database.h
+// MakeDataset() writes the attributes of every object as a line of
+// text, which has to be parsed before anything can be compared
+// against it. The binary format stores the same attributes as
+// fixed-size records after a small header, so a database file can be
+// memory-mapped and its records used in place with no parsing.
+// CheckObjectFromDatabase() accepts both formats.
+
+#ifndef COMPUTER_VISION_OBJECT_DATABASE_H_
+#define COMPUTER_VISION_OBJECT_DATABASE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ComputerVisionProjects {
+
+// One object of a database: the fields of a line of the text format,
+// in the same order:
+//   id center_row center_column min_moment area roundedness orientation
+struct ObjectRecord {
+  int32_t id = 0;
+  int32_t center_row = 0;
+  int32_t center_column = 0;
+  uint32_t padding = 0;
+  double min_moment = 0;
+  double area = 0;
+  double roundedness = 0;
+  double orientation = 0;
+};
+
+// Bits of ObjectDatabaseHeader::fields, one per field of ObjectRecord.
+enum ObjectField : uint32_t {
+  kFieldId = 1u << 0,
+  kFieldCenter = 1u << 1,
+  kFieldMinMoment = 1u << 2,
+  kFieldArea = 1u << 3,
+  kFieldRoundedness = 1u << 4,
+  kFieldOrientation = 1u << 5,
+  kAllObjectFields = (1u << 6) - 1,
+};
+
+const uint32_t kObjectDatabaseVersion = 1;
+
+// Start of a binary database file, followed by num_records records of
+// record_size bytes starting header_size bytes into the file. All
+// numbers are in the byte order of the machine that wrote the file.
+struct ObjectDatabaseHeader {
+  // "CVOBJDB" and a 0 byte.
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  uint32_t record_size;
+  // ObjectField bits of the fields that hold data.
+  uint32_t fields;
+  uint64_t num_records;
+};
+
+// Parses a text database as written by MakeDataset(): one object per
+// line, blank lines are skipped, missing trailing fields are 0.
+// Returns true if  everyhing is OK, false otherwise.
+bool ReadTextObjectDatabase(const std::string &database_file_path,
+                            std::vector<ObjectRecord> *records);
+
+// Writes records as a binary database. The file is replaced at once,
+// so readers never see it half written.
+// Returns true if  everyhing is OK, false otherwise.
+bool WriteBinaryObjectDatabase(const std::string &database_file_path,
+                               const std::vector<ObjectRecord> &records);
+
+// Writes records as a text database in the format of MakeDataset(),
+// replacing the file at once as WriteBinaryObjectDatabase() does.
+// Returns true if  everyhing is OK, false otherwise.
+bool WriteTextObjectDatabase(const std::string &database_file_path,
+                             const std::vector<ObjectRecord> &records);
+
+// Converts a text database into a binary one.
+// Returns true if  everyhing is OK, false otherwise.
+bool ConvertObjectDatabase(const std::string &text_file_path,
+                           const std::string &binary_file_path);
+
+// The records of a database file of either format. A binary file is
+// memory-mapped and its records are read in place; a text file is
+// parsed once.
+// Sample usage:
+//   ObjectDatabase database;
+//   if (!database.Open("object_database.txt")) ...
+//   for (const ObjectRecord &record: database) ...
+class ObjectDatabase {
+ public:
+  ObjectDatabase(): records_{nullptr}, num_records_{0} { }
+  ObjectDatabase(const ObjectDatabase &) = delete;
+  ObjectDatabase& operator=(const ObjectDatabase &) = delete;
+
+  // Opens a binary database, recognized by its magic, or parses a
+  // text one. A binary file with another version or record layout is
+  // rejected. Returns true if  everyhing is OK, false otherwise.
+  bool Open(const std::string &database_file_path);
+
+  const ObjectRecord *records() const { return records_; }
+  size_t size() const { return num_records_; }
+  const ObjectRecord &operator[](size_t k) const { return records_[k]; }
+  const ObjectRecord *begin() const { return records_; }
+  const ObjectRecord *end() const { return records_ + num_records_; }
+  bool is_mapped() const { return mapping_ != nullptr; }
+
+ private:
+  bool OpenBinary(const std::string &database_file_path);
+
+  const ObjectRecord *records_;
+  size_t num_records_;
+  // Records parsed from a text file.
+  std::vector<ObjectRecord> parsed_;
+  // Set for binary files; keeps the mapping alive.
+  std::shared_ptr<const void> mapping_;
+};
+
+// Opens database_file_path once per process: later calls return the
+// same database until the file changes (size, modification time or
+// inode), so repeated detections do not reload it. Safe to call from
+// several threads. Returns nullptr if the file cannot be opened.
+std::shared_ptr<const ObjectDatabase> LoadObjectDatabase(
+    const std::string &database_file_path);
+
+// Adds records to the database at database_file_path without
+// touching it: they are written to a new segment file in the
+// directory database_file_path + ".segments", created if needed, and
+// become part of the database at the next CompactObjectDatabase().
+// A segment appears at once, complete, so any number of processes
+// may append to the same database at the same time.
+// Returns true if  everyhing is OK, false otherwise.
+bool AppendObjectDatabaseSegment(const std::string &database_file_path,
+                                 const std::vector<ObjectRecord> &records);
+
+// Merges the segments appended so far into the database: its own
+// records first, then those of every segment in the order they were
+// written, numbered on from the largest id already there. The
+// database keeps its format; a new one is text if its name ends in
+// ".txt" and binary otherwise. It is replaced at once and the merged
+// segments are deleted; a journal in the segment directory lets the
+// next compaction finish one that was interrupted in between, so no
+// segment is ever merged twice. Compactions of the same database
+// are serialized with a lock file, database_file_path + ".lock", and
+// may run while other processes append.
+// Returns the number of segments merged, or -1 on error.
+int CompactObjectDatabase(const std::string &database_file_path);
+
+// Replaces the database at database_file_path with records, in the
+// text format if text is true and the binary one otherwise. Holds the
+// lock of CompactObjectDatabase() while it runs, so a compaction can
+// never rename its result over the new database, and deletes the
+// segments appended so far: they belong to the database it replaces.
+// Returns true if  everyhing is OK, false otherwise.
+bool ReplaceObjectDatabase(const std::string &database_file_path,
+                           const std::vector<ObjectRecord> &records,
+                           bool text);
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_OBJECT_DATABASE_H_
@@ -0,0 +1,73 @@
+//
+// object_features.cc
+// Center, orientation and roundedness of labeled objects.
+//
+
+#include "object_features.h"
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+
+namespace ComputerVisionProjects {
+
+    void ComputeObjectFeatures(const MomentSums &moments, vector<ObjectFeatures> *features) {
+        if (features == nullptr) abort();
+        features->clear();
+        for (int label = 1; label <= moments.num_labels(); label++) {
+            const int64_t area = moments.area[label];
+            if (area == 0) {
+                continue;
+            }
+            ObjectFeatures object;
+            object.label = label;
+            object.area = area;
+            //center of area
+            const int x_center = moments.sum_i[label] / (double) area;
+            const int y_center = moments.sum_j[label] / (double) area;
+            object.center_row = x_center;
+            object.center_column = y_center;
+
+            //second moments about the center; notice that b is
+            //multiplied by 2
+            const double a = moments.sum_ii[label] - double(x_center) * x_center * area;
+            const double b = 2.0 * moments.sum_ij[label] - 2.0 * x_center * y_center * area;
+            const double c = moments.sum_jj[label] - double(y_center) * y_center * area;
+
+            //theta, min moment, max moment
+            const double theta = atan2(b, a - c) / 2;
+            object.orientation = theta;
+            object.min_moment = a * pow(sin(theta), 2) - b * sin(theta) * cos(theta) + c * pow(cos(theta), 2);
+            const double theta_2 = theta + (M_PI / 2);
+            object.max_moment = a * pow(sin(theta_2), 2) - b * sin(theta_2) * cos(theta_2) + c * pow(cos(theta_2), 2);
+            object.roundedness = object.min_moment / object.max_moment;
+
+            object.min_row = moments.min_i[label];
+            object.max_row = moments.max_i[label];
+            object.min_column = moments.min_j[label];
+            object.max_column = moments.max_j[label];
+            features->push_back(object);
+        }
+    }
+
+    void ComputeObjectFeatures(const Image &label_image, int num_labels, vector<ObjectFeatures> *features,
+                               int num_threads) {
+        MomentSums moments;
+        AccumulateMoments(label_image, num_labels, &moments, num_threads);
+        ComputeObjectFeatures(moments, features);
+    }
+
+    void DrawOrientation(const ObjectFeatures &object, int length, int color, Image *an_image) {
+        DrawOrientation(object, length, color, 0, an_image);
+    }
+
+    void DrawOrientation(const ObjectFeatures &object, int length, int color, size_t first_row, Image *strip) {
+        const int x_orientation = object.center_row + length * cos(object.orientation);
+        const int y_orientation = object.center_column + length * sin(object.orientation);
+        //the line is moved, not recomputed, so every strip draws its part
+        //of the same pixels
+        const int offset = int(first_row);
+        DrawLine(object.center_row - offset, object.center_column, x_orientation - offset, y_orientation, color,
+                 strip);
+    }
+}  // namespace ComputerVisionProjects
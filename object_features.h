@@ -0,0 +1,66 @@
+// Features of the objects of a labeled image.
+// To be used in Computer Vision class.
+//
+// object_features.h
+// The attributes MakeDataset() stores in a database and
+// CheckObjectFromDatabase() compares against it, computed from the
+// raw moments of every object with no file or image output, so they
+// can be used and timed on their own.
+
+#ifndef COMPUTER_VISION_OBJECT_FEATURES_H_
+#define COMPUTER_VISION_OBJECT_FEATURES_H_
+
+#include "image.h"
+#include "moments.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace ComputerVisionProjects {
+
+// Attributes of one object. Rows are the x coordinate and columns
+// the y coordinate, as in MakeDataset() and DrawLine().
+struct ObjectFeatures {
+  int label = 0;
+  int64_t area = 0;
+  // Center of area, truncated to a pixel as stored in the database.
+  int center_row = 0;
+  int center_column = 0;
+  // Second moments about the axes of least and most inertia.
+  double min_moment = 0;
+  double max_moment = 0;
+  // min_moment / max_moment: 0 for a line, 1 for a disc.
+  double roundedness = 0;
+  // Angle of the axis of least inertia, in radians.
+  double orientation = 0;
+  // Bounding box, inclusive.
+  int64_t min_row = 0;
+  int64_t max_row = 0;
+  int64_t min_column = 0;
+  int64_t max_column = 0;
+};
+
+// Computes the features of every label of moments with a nonzero
+// area, in label order.
+void ComputeObjectFeatures(const MomentSums &moments,
+                           std::vector<ObjectFeatures> *features);
+
+// Same from a label image with labels 1..num_labels, with its moments
+// accumulated on num_threads threads (see AccumulateMoments()).
+void ComputeObjectFeatures(const Image &label_image, int num_labels,
+                           std::vector<ObjectFeatures> *features,
+                           int num_threads = 1);
+
+// Draws a line of the given length and gray level from the center of
+// object along its orientation.
+void DrawOrientation(const ObjectFeatures &object, int length, int color,
+                     Image *an_image);
+
+// Same on a strip of an image whose first row is row first_row of the
+// image; the parts of the line outside the strip are not drawn.
+void DrawOrientation(const ObjectFeatures &object, int length, int color,
+                     size_t first_row, Image *strip);
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_OBJECT_FEATURES_H_
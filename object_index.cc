@@ -0,0 +1,167 @@
+//
+// object_index.cc
+// k-d tree over the features of a database of known objects.
+//
+
+#include "object_index.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+
+using namespace std;
+
+namespace ComputerVisionProjects {
+
+    namespace {
+        //subtrees this small are scanned instead of split
+        const size_t kLeafSize = 8;
+
+        bool IsBetter(const ObjectMatch &a, const ObjectMatch &b) {
+            return a.score < b.score || (a.score == b.score && a.index < b.index);
+        }
+
+        //range of the features of the records that can be within
+        //kMatchTolerance of value, widened so that rounding cannot leave
+        //a match out; the exact test is done on every record in range
+        void ToleranceRange(double value, double *low, double *high) {
+            const double a = value / (1 + kMatchTolerance);
+            const double b = value / (1 - kMatchTolerance);
+            const double margin = fabs(value) * 1e-9;
+            *low = min(a, b) - margin;
+            *high = max(a, b) + margin;
+        }
+    }
+
+    ObjectIndex::ObjectIndex(shared_ptr<const ObjectDatabase> database)
+            : database_{std::move(database)} {
+        //records with a NaN or infinite feature (the roundedness of a
+        //one pixel object is 0/0) never match, and NaN keys would break
+        //the ordering the tree is built and pruned on: they are left out
+        ids_.reserve(database_->size());
+        for (size_t k = 0; k < database_->size(); ++k) {
+            const ObjectRecord &record = (*database_)[k];
+            if (isfinite(record.area) && isfinite(record.roundedness)) ids_.push_back(uint32_t(k));
+        }
+        Build(0, ids_.size(), 0);
+
+        const size_t num_records = ids_.size();
+        features_[0].resize(num_records);
+        features_[1].resize(num_records);
+        min_area_.resize(num_records);
+        max_area_.resize(num_records);
+        min_roundedness_.resize(num_records);
+        max_roundedness_.resize(num_records);
+        for (size_t k = 0; k < num_records; ++k) {
+            const ObjectRecord &record = (*database_)[ids_[k]];
+            features_[0][k] = record.area;
+            features_[1][k] = record.roundedness;
+            const double area_difference = kMatchTolerance * record.area;
+            const double roundedness_difference = kMatchTolerance * record.roundedness;
+            min_area_[k] = record.area - area_difference;
+            max_area_[k] = record.area + area_difference;
+            min_roundedness_[k] = record.roundedness - roundedness_difference;
+            max_roundedness_[k] = record.roundedness + roundedness_difference;
+        }
+    }
+
+    void ObjectIndex::Build(size_t begin, size_t end, int depth) {
+        if (end - begin <= kLeafSize) return;
+        const size_t middle = begin + (end - begin) / 2;
+        const ObjectDatabase &records = *database_;
+        auto feature = [&](uint32_t id) { return depth % 2 == 0 ? records[id].area : records[id].roundedness; };
+        nth_element(ids_.begin() + begin, ids_.begin() + middle, ids_.begin() + end, [&](uint32_t a, uint32_t b) {
+            return feature(a) < feature(b) || (feature(a) == feature(b) && a < b);
+        });
+        Build(begin, middle, depth + 1);
+        Build(middle + 1, end, depth + 1);
+    }
+
+    void ObjectIndex::Match(double area, double roundedness, vector<uint32_t> *matches) const {
+        double low[2];
+        double high[2];
+        ToleranceRange(area, &low[0], &high[0]);
+        ToleranceRange(roundedness, &low[1], &high[1]);
+        const size_t first_match = matches->size();
+        Query(0, size(), 0, low, high, area, roundedness, matches);
+        sort(matches->begin() + first_match, matches->end());
+    }
+
+    void ObjectIndex::Query(size_t begin, size_t end, int depth, const double low[2], const double high[2],
+                            double area, double roundedness, vector<uint32_t> *matches) const {
+        auto test = [&](size_t k) {
+            if ((area >= min_area_[k]) & (area <= max_area_[k]) &
+                (roundedness >= min_roundedness_[k]) & (roundedness <= max_roundedness_[k]))
+                matches->push_back(ids_[k]);
+        };
+        if (end - begin <= kLeafSize) {
+            for (size_t k = begin; k < end; ++k) test(k);
+            return;
+        }
+        const size_t middle = begin + (end - begin) / 2;
+        const int axis = depth % 2;
+        const double split = features_[axis][middle];
+        if (low[axis] <= split) Query(begin, middle, depth + 1, low, high, area, roundedness, matches);
+        test(middle);
+        if (high[axis] >= split) Query(middle + 1, end, depth + 1, low, high, area, roundedness, matches);
+    }
+
+    void ObjectIndex::Nearest(double area, double roundedness, size_t k, vector<ObjectMatch> *matches) const {
+        matches->clear();
+        if (k == 0) return;
+        //differences are relative to the object, so every axis is
+        //scaled by a fixed weight and the tree can prune by distance
+        const double query[2] = {area, roundedness};
+        const double weight[2] = {1 / max(area * area, 1e-300), 1 / max(roundedness * roundedness, 1e-300)};
+        Search(0, size(), 0, query, weight, k, matches);
+        sort_heap(matches->begin(), matches->end(), IsBetter);
+    }
+
+    void ObjectIndex::Search(size_t begin, size_t end, int depth, const double query[2], const double weight[2],
+                             size_t k, vector<ObjectMatch> *heap) const {
+        //heap keeps the best k so far, the worst of them at the front
+        auto consider = [&](size_t r) {
+            const double area_difference = features_[0][r] - query[0];
+            const double roundedness_difference = features_[1][r] - query[1];
+            const ObjectMatch match{ids_[r], weight[0] * area_difference * area_difference +
+                                             weight[1] * roundedness_difference * roundedness_difference};
+            if (heap->size() < k) {
+                heap->push_back(match);
+                push_heap(heap->begin(), heap->end(), IsBetter);
+            } else if (IsBetter(match, heap->front())) {
+                pop_heap(heap->begin(), heap->end(), IsBetter);
+                heap->back() = match;
+                push_heap(heap->begin(), heap->end(), IsBetter);
+            }
+        };
+        if (end - begin <= kLeafSize) {
+            for (size_t r = begin; r < end; ++r) consider(r);
+            return;
+        }
+        const size_t middle = begin + (end - begin) / 2;
+        const int axis = depth % 2;
+        const double difference = query[axis] - features_[axis][middle];
+        //the side of the split the query is on first; the other side
+        //only if its records can still be as close as the worst kept
+        const bool left_first = difference < 0;
+        if (left_first) Search(begin, middle, depth + 1, query, weight, k, heap);
+        else Search(middle + 1, end, depth + 1, query, weight, k, heap);
+        consider(middle);
+        if (heap->size() < k || weight[axis] * difference * difference <= heap->front().score) {
+            if (left_first) Search(middle + 1, end, depth + 1, query, weight, k, heap);
+            else Search(begin, middle, depth + 1, query, weight, k, heap);
+        }
+    }
+
+    shared_ptr<const ObjectIndex> LoadObjectIndex(const string &database_file_path) {
+        static mutex cache_mutex;
+        static map<string, shared_ptr<const ObjectIndex>> cache;
+
+        shared_ptr<const ObjectDatabase> database = LoadObjectDatabase(database_file_path);
+        if (database == nullptr) return nullptr;
+        lock_guard<mutex> lock(cache_mutex);
+        shared_ptr<const ObjectIndex> &index = cache[database_file_path];
+        if (index == nullptr || &index->database() != database.get()) index = make_shared<ObjectIndex>(database);
+        return index;
+    }
+}  // namespace ComputerVisionProjects
@@ -0,0 +1,93 @@
+// Spatial index of a database of known objects.
+// To be used in Computer Vision class.
+//
+// object_index.h
+// An ObjectMatcher compares an object against every record of the
+// database. An ObjectIndex sorts the records into a k-d tree over
+// their area and roundedness, so a query only visits the records
+// near the object: a tolerance query returns the same matches as
+// ObjectMatcher::Match(), and a nearest neighbor query the k records
+// most similar to the object.
+
+#ifndef COMPUTER_VISION_OBJECT_INDEX_H_
+#define COMPUTER_VISION_OBJECT_INDEX_H_
+
+#include "object_database.h"
+#include "object_matcher.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ComputerVisionProjects {
+
+// A record found by a nearest neighbor query.
+struct ObjectMatch {
+  // Index of the record in the database.
+  uint32_t index;
+  // Sum over area and roundedness of the squared difference between
+  // the record and the object, relative to the object:
+  // ((record - object) / object)^2. 0 for identical features.
+  double score;
+};
+
+class ObjectIndex {
+ public:
+  // Indexes the records of database, which is kept alive by the index.
+  explicit ObjectIndex(std::shared_ptr<const ObjectDatabase> database);
+
+  const ObjectDatabase &database() const { return *database_; }
+  // Number of records in the tree. Records whose area or roundedness
+  // is NaN or infinite cannot match anything and are not indexed.
+  size_t size() const { return ids_.size(); }
+
+  // Appends to matches, in database order, the index of every record
+  // within kMatchTolerance of area and roundedness, with the same
+  // test as ObjectMatcher::Match().
+  void Match(double area, double roundedness,
+             std::vector<uint32_t> *matches) const;
+
+  // Sets matches to the (at most) k records with the lowest score,
+  // lowest first; records with the same score are in database order.
+  void Nearest(double area, double roundedness, size_t k,
+               std::vector<ObjectMatch> *matches) const;
+
+ private:
+  // Sorts ids_[begin..end) into a subtree split on area at even depths
+  // and roundedness at odd ones: the median is at the middle, the
+  // records before it are <= it and the ones after it >= it.
+  void Build(size_t begin, size_t end, int depth);
+  void Query(size_t begin, size_t end, int depth, const double low[2],
+             const double high[2], double area, double roundedness,
+             std::vector<uint32_t> *matches) const;
+  void Search(size_t begin, size_t end, int depth, const double query[2],
+              const double weight[2], size_t k,
+              std::vector<ObjectMatch> *heap) const;
+
+  std::shared_ptr<const ObjectDatabase> database_;
+  // Record indices in tree order, and their features in the same order.
+  std::vector<uint32_t> ids_;
+  std::vector<double> features_[2];
+  // Tolerance bounds in tree order, as in ObjectMatcher.
+  std::vector<double> min_area_;
+  std::vector<double> max_area_;
+  std::vector<double> min_roundedness_;
+  std::vector<double> max_roundedness_;
+};
+
+// Databases with at least this many records are matched through an
+// ObjectIndex by CheckObjectFromDatabase(); smaller ones are scanned.
+const size_t kMinIndexedRecords = 1024;
+
+// The index of the database LoadObjectDatabase() returns for
+// database_file_path, built once and rebuilt only when the database
+// is reloaded. Safe to call from several threads. Returns nullptr if
+// the file cannot be opened.
+std::shared_ptr<const ObjectIndex> LoadObjectIndex(
+    const std::string &database_file_path);
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_OBJECT_INDEX_H_
@@ -0,0 +1,89 @@
+//
+// object_index_test.cpp
+// Checks that ObjectIndex::Match() finds the same records as
+// ObjectMatcher::Match() on random databases, with and without
+// records whose features are NaN or infinite.
+//
+
+#include "object_database.h"
+#include "object_index.h"
+#include "object_matcher.h"
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+
+using namespace std;
+using namespace ComputerVisionProjects;
+
+namespace {
+    //number of queries of a database whose results differ between
+    //the index and the linear matcher
+    size_t CountMismatches(const string &database_file, double non_finite_fraction, mt19937 *generator) {
+        uniform_real_distribution<double> area(1, 5000);
+        uniform_real_distribution<double> roundedness(0, 1);
+        uniform_real_distribution<double> unit(0, 1);
+        const double non_finite[] = {numeric_limits<double>::quiet_NaN(), numeric_limits<double>::infinity(),
+                                     -numeric_limits<double>::infinity()};
+
+        vector<ObjectRecord> records(3000);
+        for (size_t k = 0; k < records.size(); ++k) {
+            records[k].id = int32_t(k + 1);
+            records[k].area = area(*generator);
+            records[k].roundedness = roundedness(*generator);
+            if (unit(*generator) < non_finite_fraction) {
+                const double value = non_finite[(*generator)() % 3];
+                if ((*generator)() % 2 == 0) records[k].roundedness = value;
+                else records[k].area = value;
+            }
+        }
+        if (!WriteBinaryObjectDatabase(database_file, records)) {
+            cout << "Can't write to file " << database_file << endl;
+            return 1;
+        }
+        shared_ptr<ObjectDatabase> database = make_shared<ObjectDatabase>();
+        if (!database->Open(database_file)) {
+            cout << "Can't open file " << database_file << endl;
+            return 1;
+        }
+
+        const ObjectMatcher matcher(*database);
+        const ObjectIndex index(database);
+        size_t mismatches = 0;
+        vector<uint32_t> expected;
+        vector<uint32_t> found;
+        for (int query = 0; query < 20000; ++query) {
+            //half of the queries are near a record, so that most match
+            const ObjectRecord &near = records[(*generator)() % records.size()];
+            const double object_area = query % 2 == 0 ? area(*generator) : near.area * (0.7 + 0.6 * unit(*generator));
+            const double object_roundedness = query % 2 == 0 ? roundedness(*generator)
+                                                             : near.roundedness * (0.7 + 0.6 * unit(*generator));
+            expected.clear();
+            found.clear();
+            matcher.Match(object_area, object_roundedness, &expected);
+            index.Match(object_area, object_roundedness, &found);
+            if (expected != found) ++mismatches;
+        }
+        return mismatches;
+    }
+}
+
+int
+main(int argc, char **argv){
+
+    const string database_file = argc > 1 ? argv[1] : "object_index_test.db";
+    mt19937 generator(2);
+    int failures = 0;
+    for (double non_finite_fraction: {0.0, 0.05, 0.3}) {
+        const size_t mismatches = CountMismatches(database_file, non_finite_fraction, &generator);
+        printf("%g%% non-finite records: %zu mismatches\n", 100 * non_finite_fraction, mismatches);
+        if (mismatches != 0) ++failures;
+    }
+    remove(database_file.c_str());
+    return failures == 0 ? 0 : 1;
+}
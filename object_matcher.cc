@@ -0,0 +1,127 @@
+//
+// object_matcher.cc
+// Matching of objects against a database of known objects. The
+// widest instruction set the CPU supports is picked once, at the
+// first call.
+//
+
+#include "object_matcher.h"
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define COMPUTER_VISION_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace ComputerVisionProjects {
+
+    namespace {
+        //tests one object against 64 records: bit k of the result is set
+        //when every feature of the object is within the bounds of record k
+        typedef uint64_t (*MatchWordKernel)(const double *const low[kNumMatchedFeatures],
+                                            const double *const high[kNumMatchedFeatures], const double *object);
+
+        uint64_t MatchWordScalar(const double *const low[kNumMatchedFeatures],
+                                 const double *const high[kNumMatchedFeatures], const double *object) {
+            uint64_t bits = 0;
+            for (int k = 0; k < 64; ++k) {
+                bool match = true;
+                for (int f = 0; f < kNumMatchedFeatures; ++f)
+                    match &= (object[f] >= low[f][k]) & (object[f] <= high[f][k]);
+                bits |= uint64_t(match) << k;
+            }
+            return bits;
+        }
+
+#ifdef COMPUTER_VISION_X86
+        __attribute__((target("avx2")))
+        uint64_t MatchWordAvx2(const double *const low[kNumMatchedFeatures],
+                               const double *const high[kNumMatchedFeatures], const double *object) {
+            __m256d value[kNumMatchedFeatures];
+            for (int f = 0; f < kNumMatchedFeatures; ++f) value[f] = _mm256_set1_pd(object[f]);
+            uint64_t bits = 0;
+            for (int k = 0; k < 64; k += 4) {
+                //ordered comparisons, false for NaN as in the scalar test
+                __m256d match = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+                for (int f = 0; f < kNumMatchedFeatures; ++f) {
+                    const __m256d above = _mm256_cmp_pd(value[f], _mm256_loadu_pd(low[f] + k), _CMP_GE_OQ);
+                    const __m256d below = _mm256_cmp_pd(value[f], _mm256_loadu_pd(high[f] + k), _CMP_LE_OQ);
+                    match = _mm256_and_pd(match, _mm256_and_pd(above, below));
+                }
+                bits |= uint64_t(_mm256_movemask_pd(match)) << k;
+            }
+            return bits;
+        }
+#endif
+
+        MatchWordKernel SelectKernel() {
+#ifdef COMPUTER_VISION_X86
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2")) return MatchWordAvx2;
+#endif
+            return MatchWordScalar;
+        }
+
+        MatchWordKernel Kernel() {
+            static const MatchWordKernel kernel = SelectKernel();
+            return kernel;
+        }
+    }
+
+    ObjectMatcher::ObjectMatcher(const ObjectRecord *records, size_t num_records) : num_records_{num_records} {
+        const size_t padded_size = words_per_object() * 64;
+        for (int f = 0; f < kNumMatchedFeatures; ++f) {
+            min_[f].assign(padded_size, numeric_limits<double>::infinity());
+            max_[f].assign(padded_size, -numeric_limits<double>::infinity());
+        }
+        for (size_t k = 0; k < num_records; ++k) {
+            const double ground[kNumMatchedFeatures] = {records[k].area, records[k].roundedness};
+            for (int f = 0; f < kNumMatchedFeatures; ++f) {
+                const double difference = kMatchTolerance * ground[f];
+                min_[f][k] = ground[f] - difference;
+                max_[f][k] = ground[f] + difference;
+            }
+        }
+    }
+
+    void ObjectMatcher::Match(double area, double roundedness, vector<uint32_t> *matches) const {
+        const double object[kNumMatchedFeatures] = {area, roundedness};
+        const MatchWordKernel kernel = Kernel();
+        for (size_t word = 0; word < words_per_object(); ++word) {
+            const double *low[kNumMatchedFeatures];
+            const double *high[kNumMatchedFeatures];
+            for (int f = 0; f < kNumMatchedFeatures; ++f) {
+                low[f] = min_[f].data() + word * 64;
+                high[f] = max_[f].data() + word * 64;
+            }
+            for (uint64_t bits = kernel(low, high, object); bits != 0; bits &= bits - 1)
+                matches->push_back(uint32_t(word * 64 + __builtin_ctzll(bits)));
+        }
+    }
+
+    void ObjectMatcher::MatchAll(const double *const features[kNumMatchedFeatures], size_t num_objects,
+                                 vector<uint64_t> *matches) const {
+        const size_t num_words = words_per_object();
+        matches->assign(num_objects * num_words, 0);
+        //the objects as rows of features, to be broadcast
+        vector<double> objects(num_objects * kNumMatchedFeatures);
+        for (size_t o = 0; o < num_objects; ++o)
+            for (int f = 0; f < kNumMatchedFeatures; ++f) objects[o * kNumMatchedFeatures + f] = features[f][o];
+
+        //every block of 64 records is tested against all the objects
+        //while its bounds are in the cache
+        const MatchWordKernel kernel = Kernel();
+        for (size_t word = 0; word < num_words; ++word) {
+            const double *low[kNumMatchedFeatures];
+            const double *high[kNumMatchedFeatures];
+            for (int f = 0; f < kNumMatchedFeatures; ++f) {
+                low[f] = min_[f].data() + word * 64;
+                high[f] = max_[f].data() + word * 64;
+            }
+            for (size_t o = 0; o < num_objects; ++o)
+                (*matches)[o * num_words + word] = kernel(low, high, &objects[o * kNumMatchedFeatures]);
+        }
+    }
+}  // namespace ComputerVisionProjects
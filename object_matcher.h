@@ -0,0 +1,70 @@
+// Matching of objects against a database of known objects.
+// To be used in Computer Vision class.
+//
+// object_matcher.h
+// CheckObjectFromDatabase() recognizes an object when its area and
+// its roundedness are both within 35% of those of a database record.
+// An ObjectMatcher computes the bounds of every record once and keeps
+// them in a struct of arrays, one array per feature, so the objects
+// of a frame are compared against the whole database 64 records at
+// a time with AVX2 where the CPU has it.
+
+#ifndef COMPUTER_VISION_OBJECT_MATCHER_H_
+#define COMPUTER_VISION_OBJECT_MATCHER_H_
+
+#include "object_database.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ComputerVisionProjects {
+
+// Relative tolerance of a match, chosen by testing.
+const double kMatchTolerance = 0.35;
+
+// Features an object has to match, in the order the feature arrays
+// of ObjectMatcher take them. A feature is added here and read from
+// the records in the ObjectMatcher constructor.
+enum MatchedFeature {
+  kMatchArea,
+  kMatchRoundedness,
+  kNumMatchedFeatures
+};
+
+class ObjectMatcher {
+ public:
+  ObjectMatcher(const ObjectRecord *records, size_t num_records);
+  explicit ObjectMatcher(const ObjectDatabase &database)
+      : ObjectMatcher(database.records(), database.size()) { }
+
+  size_t size() const { return num_records_; }
+  // Words per object of the matrix of MatchAll().
+  size_t words_per_object() const { return (num_records_ + 63) / 64; }
+
+  // Appends to matches, in database order, the index of every record
+  // whose area and roundedness are both within kMatchTolerance of
+  // area and roundedness: ground * (1 - tolerance) <= value <=
+  // ground * (1 + tolerance), computed as ground -/+ tolerance * ground.
+  void Match(double area, double roundedness,
+             std::vector<uint32_t> *matches) const;
+
+  // Tests num_objects objects against every record at once.
+  // features[f][o] is MatchedFeature f of object o. matches is set to
+  // a bit matrix of num_objects rows of words_per_object() words: bit
+  // k % 64 of word k / 64 of row o is set when object o matches
+  // record k, with the same test as Match().
+  void MatchAll(const double *const features[kNumMatchedFeatures],
+                size_t num_objects, std::vector<uint64_t> *matches) const;
+
+ private:
+  size_t num_records_;
+  // Bounds of every feature, padded to a multiple of 64 records with
+  // bounds that nothing matches.
+  std::vector<double> min_[kNumMatchedFeatures];
+  std::vector<double> max_[kNumMatchedFeatures];
+};
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_OBJECT_MATCHER_H_
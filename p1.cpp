@@ -23,20 +23,30 @@ int
 main(int argc, char **argv){
 
     if (argc!=4) {
-        printf("Usage: %s file1 file2\n", argv[0]);
+        printf("Usage: %s file1 treshold file2\n", argv[0]);
+        printf("  treshold is a gray level, otsu, triangle, bradley or sauvola\n");
         return 0;
     }
     const string input_file(argv[1]);
     const string treshold(argv[2]);
     const string output_file(argv[3]);
+    ThresholdMethod method;
+    int treshold_value = 0;
+    if (!ParseThreshold(treshold, &method, &treshold_value)) {
+        cout << "Invalid treshold " << treshold << endl;
+        return 0;
+    }
     Image an_image;
-    if (!ReadImage(input_file, &an_image)) {
+    if (!ReadImageMapped(input_file, &an_image)) {
         cout <<"Can't open file " << input_file << endl;
         return 0;
     }
 
     //P1
-    ConvertToBinary(int(stod(treshold)),&an_image);
+    treshold_value = ConvertToBinary(method, treshold_value, &an_image);
+    if (treshold_value >= 0 && method != ThresholdMethod::kFixed) {
+        cout << "Selected treshold " << treshold_value << endl;
+    }
 
 
 
@@ -8,6 +8,8 @@
 
 #include "image.h"
 #include "DisjSets.h"
+#include "labeling.h"
+#include <chrono>
 #include <cstdio>
 #include <iostream>
 #include <string>
@@ -18,28 +20,110 @@ using std::unordered_map;
 using namespace std;
 using namespace ComputerVisionProjects;
 
+namespace {
+    //number of pixels where two images differ
+    size_t CountDifferentPixels(const Image &an_image, const Image &other) {
+        size_t different = 0;
+        for (size_t i = 0; i < an_image.num_rows(); i++)
+            for (size_t j = 0; j < an_image.num_columns(); j++)
+                if (an_image.GetPixel(i, j) != other.GetPixel(i, j)) different++;
+        return different;
+    }
+
+    //labels a copy of binary_image with every algorithm and compares
+    //the results with flood fill; returns true if they all agree
+    bool VerifyAlgorithms(const Image &binary_image, Connectivity connectivity) {
+        Image reference_labels, reference;
+        const int num_labels = LabelFloodFill(binary_image, connectivity, &reference_labels);
+        RenderLabels(reference_labels, &reference);
+        cout << "floodfill: " << num_labels << " objects" << endl;
+
+        Image sequential_labels;
+        LabelBinarySequentially(binary_image, &sequential_labels, connectivity);
+        RunLengthLabels runs;
+        Image run_image;
+        LabelRunLength(binary_image, &runs, connectivity);
+        RenderLabels(runs, &run_image);
+        Image block_labels, parallel_labels;
+        LabelBlockBased(binary_image, connectivity, &block_labels);
+        //enough stripes to have boundaries even on small images
+        LabelBlockBased(binary_image, connectivity, &parallel_labels, 8);
+
+        bool all_agree = true;
+        auto report = [&](const char *name, size_t different) {
+            cout << name << ": " << (different == 0 ? "ok" : to_string(different) + " pixels differ") << endl;
+            all_agree = all_agree && different == 0;
+        };
+        report("sequential", CountDifferentPixels(sequential_labels, reference_labels));
+        report("runs", CountDifferentPixels(run_image, reference));
+        report("blocks", CountDifferentPixels(block_labels, reference_labels));
+        report("parallel", CountDifferentPixels(parallel_labels, reference_labels));
+        return all_agree;
+    }
+}
+
 int
 main(int argc, char **argv){
 
-    if (argc!=3) {
-        printf("Usage: %s file1 file2\n", argv[0]);
+    if (argc < 3 || argc > 5) {
+        printf("Usage: %s file1 file2 [algorithm] [connectivity]\n", argv[0]);
+        printf("  algorithm is sequential (default), runs, blocks, parallel\n");
+        printf("  (blocks on one stripe per hardware thread) or floodfill,\n");
+        printf("  or verify to check all of them against floodfill\n");
+        printf("  connectivity is 8 (default) or 4\n");
         return 0;
     }
     const string input_file(argv[1]);
     const string output_file(argv[2]);
+    const string algorithm(argc >= 4 ? argv[3] : "sequential");
+    if (algorithm != "sequential" && algorithm != "runs" && algorithm != "blocks" &&
+        algorithm != "parallel" && algorithm != "floodfill" && algorithm != "verify") {
+        cout << "Unknown algorithm " << algorithm << endl;
+        return 0;
+    }
+    const string connectivity_text(argc == 5 ? argv[4] : "8");
+    if (connectivity_text != "4" && connectivity_text != "8") {
+        cout << "Unknown connectivity " << connectivity_text << endl;
+        return 0;
+    }
+    const Connectivity connectivity = connectivity_text == "4" ? Connectivity::kFour : Connectivity::kEight;
 
     Image an_image;
-    if (!ReadImage(input_file, &an_image)) {
+    if (!ReadImageMapped(input_file, &an_image)) {
         cout <<"Can't open file " << input_file << endl;
         return 0;
     }
 
-    //P2
-    LabelBinarySequentially(&an_image);
+    if (algorithm == "verify") {
+        if (!VerifyAlgorithms(an_image, connectivity)) return 1;
+        Image labels;
+        LabelFloodFill(an_image, connectivity, &labels);
+        RenderLabels(labels, &an_image);
+    } else {
+        //P2
+        //the labeling time is printed so the algorithms can be compared
+        const auto start = chrono::steady_clock::now();
+        if (algorithm == "runs") {
+            RunLengthLabels labels;
+            LabelRunLength(an_image, &labels, connectivity);
+            RenderLabels(labels, &an_image);
+        } else if (algorithm == "blocks" || algorithm == "parallel" || algorithm == "floodfill") {
+            Image labels;
+            if (algorithm == "blocks") LabelBlockBased(an_image, connectivity, &labels);
+            else if (algorithm == "parallel") LabelBlockBased(an_image, connectivity, &labels, 0);
+            else LabelFloodFill(an_image, connectivity, &labels);
+            RenderLabels(labels, &an_image);
+        } else {
+            Image labels;
+            LabelBinarySequentially(an_image, &labels, connectivity);
+            RenderLabels(labels, &an_image);
+        }
+        const chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+        cout << "Labeling (" << algorithm << "): " << elapsed.count() << " ms" << endl;
+    }
 
     if (!WriteImage(output_file, an_image)){
         cout << "Can't write to file " << output_file << endl;
         return 0;
     }
 }
-
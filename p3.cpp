@@ -22,8 +22,10 @@ using namespace ComputerVisionProjects;
 int
 main(int argc, char **argv){
 
-    if (argc!=4) {
-        printf("Usage: %s file1 file2\n", argv[0]);
+    if (argc != 4 && argc != 5) {
+        printf("Usage: %s file1 database file2 [append]\n", argv[0]);
+        printf("  with append the objects are added to the database as a new segment,\n");
+        printf("  merged in by convert_database -compact database\n");
         return 0;
     }
 
@@ -31,9 +33,14 @@ main(int argc, char **argv){
     const string input_file(argv[1]);
     const string database(argv[2]);
     const string output_file(argv[3]);
+    if (argc == 5 && string(argv[4]) != "append") {
+        cout << "Unknown mode " << argv[4] << endl;
+        return 0;
+    }
+    const DatasetMode mode = argc == 5 ? DatasetMode::kAppend : DatasetMode::kReplace;
 
     Image an_image;
-    if (!ReadImage(input_file, &an_image)) {
+    if (!ReadImageMapped(input_file, &an_image)) {
         cout <<"Can't open file " << input_file << endl;
         return 0;
     }
@@ -41,7 +48,12 @@ main(int argc, char **argv){
 
 
 //p3
-    MakeDataset(database,&an_image);
+    //the objects of p2 are found again by connectivity rather than by
+    //their gray levels, which repeat every 32 labels
+    Image labels;
+    const int num_labels = LabelBinarySequentially(an_image, &labels);
+    //the moments are accumulated on every hardware thread
+    MakeDataset(database, labels, num_labels, &an_image, 0, mode);
 
     if (!WriteImage(output_file, an_image)){
         cout << "Can't write to file " << output_file << endl;
@@ -9,7 +9,12 @@
 
 #include "image.h"
 #include "DisjSets.h"
+#include "frame_sequence.h"
+#include "labeling.h"
+#include "object_features.h"
+#include "streaming.h"
 #include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <string>
 #include <unordered_map>
@@ -19,28 +24,173 @@ using std::unordered_map;
 using namespace std;
 using namespace ComputerVisionProjects;
 
+//output name of frame k of a sequence: out.pgm -> out_k.pgm
+static string FrameOutputName(const string &output_file, size_t k) {
+    const size_t dot = output_file.find_last_of('.');
+    if (dot == string::npos) return output_file + "_" + to_string(k);
+    return output_file.substr(0, dot) + "_" + to_string(k) + output_file.substr(dot);
+}
+
+//detects the objects of every frame listed in list_file, one file
+//name per line, labeling again only what changed since the last frame
+static int DetectInSequence(const string &list_file, const string &database, const string &output_file,
+                            ThresholdMethod method, int treshold_value) {
+    ifstream list(list_file);
+    if (!list) {
+        cout << "Can't open file " << list_file << endl;
+        return 0;
+    }
+    FrameSequenceLabeler labeler(0);
+    string frame_file;
+    size_t k = 0;
+    while (getline(list, frame_file)) {
+        if (frame_file.empty()) continue;
+        Image frame;
+        if (!ReadImageMapped(frame_file, &frame)) {
+            cout << "Can't open file " << frame_file << endl;
+            return 0;
+        }
+        //the treshold of the first frame is kept for the whole sequence
+        if (k == 0) {
+            treshold_value = SelectThreshold(method, treshold_value, frame);
+            if (method != ThresholdMethod::kFixed) {
+                cout << "Selected treshold " << treshold_value << endl;
+            }
+            labeler = FrameSequenceLabeler(treshold_value);
+        }
+        const size_t tiles = labeler.AddFrame(frame);
+        cout << "Frame " << k << ": " << labeler.num_objects() << " objects, " << tiles << " of "
+             << labeler.num_tiles() << " tiles labeled" << endl;
+        CheckObjectFromDatabase(database, labeler.moments(), &frame);
+        const string frame_output = FrameOutputName(output_file, k);
+        if (!WriteImage(frame_output, frame)) {
+            cout << "Can't write to file " << frame_output << endl;
+            return 0;
+        }
+        ++k;
+    }
+    return 0;
+}
+
+//rows of the input kept in memory by the strips algorithm
+static const size_t kStripRows = 256;
+
+//detects the objects of a pgm file without ever loading it whole: it is
+//labeled strip by strip, then copied to output_file strip by strip with
+//the detections drawn on the way
+static int DetectInStrips(const string &input_file, const string &database, const string &output_file,
+                          int treshold_value) {
+    vector<ComponentMoments> components;
+    if (!LabelPgmInStrips(input_file, treshold_value, kStripRows, &components)) {
+        cout << "Can't open file " << input_file << endl;
+        return 0;
+    }
+    vector<ObjectFeatures> detected;
+    CheckObjectFromDatabase(database, components, &detected);
+
+    PgmStripReader reader;
+    if (!reader.Open(input_file)) {
+        cout << "Can't open file " << input_file << endl;
+        return 0;
+    }
+    FILE *output = fopen(output_file.c_str(), "wb");
+    if (output == nullptr) {
+        cout << "Can't write to file " << output_file << endl;
+        return 0;
+    }
+    const PgmHeader &header = reader.header();
+    WritePgmHeader(output, header.num_rows, header.num_columns, header.max_gray);
+    Image strip;
+    bool complete = true;
+    size_t rows_read;
+    while (complete && (rows_read = reader.ReadStrip(kStripRows, &strip)) > 0) {
+        const size_t first_row = reader.next_row() - rows_read;
+        //as CheckObjectFromDatabase() draws them on a whole image
+        for (const ObjectFeatures &object: detected) DrawOrientation(object, 35, 250, first_row, &strip);
+        complete = WritePgmPixels(output, strip, rows_read);
+    }
+    if (fclose(output) != 0 || !complete || reader.next_row() != header.num_rows) {
+        cout << "Can't write to file " << output_file << endl;
+    }
+    return 0;
+}
+
 int
 main(int argc, char **argv){
 
-    if (argc!=4) {
-        printf("Usage: %s file1 file2\n", argv[0]);
+    if (argc < 4 || argc > 6) {
+        printf("Usage: %s file1 database file2 [treshold] [algorithm]\n", argv[0]);
+        printf("  treshold is a gray level (default 128), otsu, triangle, bradley or sauvola\n");
+        printf("  algorithm is labeled (default), which draws on the labeled image, or fused,\n");
+        printf("  which thresholds, labels and measures in one pass and draws on file1, or\n");
+        printf("  sequence, which reads the frames listed in file1, one per line, labels again\n");
+        printf("  only what changed from frame to frame and writes frame k to file2_k, or\n");
+        printf("  strips, which reads file1 a few rows at a time, for images larger than memory;\n");
+        printf("  it needs a gray level treshold\n");
         return 0;
     }
 
     const string input_file(argv[1]);
     const string database(argv[2]);
     const string output_file(argv[3]);
+    ThresholdMethod method = ThresholdMethod::kFixed;
+    int treshold_value = 128;
+    if (argc >= 5 && !ParseThreshold(argv[4], &method, &treshold_value)) {
+        cout << "Invalid treshold " << argv[4] << endl;
+        return 0;
+    }
+    const string algorithm(argc == 6 ? argv[5] : "labeled");
+    if (algorithm != "labeled" && algorithm != "fused" && algorithm != "sequence" && algorithm != "strips") {
+        cout << "Unknown algorithm " << algorithm << endl;
+        return 0;
+    }
+    if (algorithm != "labeled" && (method == ThresholdMethod::kBradley || method == ThresholdMethod::kSauvola)) {
+        cout << "The " << algorithm << " algorithm needs a global treshold" << endl;
+        return 0;
+    }
+    if (algorithm == "sequence") {
+        return DetectInSequence(input_file, database, output_file, method, treshold_value);
+    }
+    if (algorithm == "strips") {
+        //otsu and triangle would need the whole image for their histogram
+        if (method != ThresholdMethod::kFixed) {
+            cout << "The strips algorithm needs a gray level treshold" << endl;
+            return 0;
+        }
+        return DetectInStrips(input_file, database, output_file, treshold_value);
+    }
 
     Image an_image;
-    if (!ReadImage(input_file, &an_image)) {
+    if (!ReadImageMapped(input_file, &an_image)) {
         cout <<"Can't open file " << input_file << endl;
         return 0;
     }
 
     //p4
-    ConvertToBinary(128,&an_image);
-    LabelBinarySequentially(&an_image);
-    CheckObjectFromDatabase(database,&an_image);
+    if (algorithm == "fused") {
+        //no binary or labeled image is written, the objects are measured
+        //while the input is read
+        treshold_value = SelectThreshold(method, treshold_value, an_image);
+        if (method != ThresholdMethod::kFixed) {
+            cout << "Selected treshold " << treshold_value << endl;
+        }
+        vector<ComponentMoments> components;
+        LabelThresholded(an_image, treshold_value, &components);
+        CheckObjectFromDatabase(database, components, &an_image);
+    } else {
+        treshold_value = ConvertToBinary(method, treshold_value, &an_image);
+        if (treshold_value >= 0 && method != ThresholdMethod::kFixed) {
+            cout << "Selected treshold " << treshold_value << endl;
+        }
+        //the objects are measured on the label image, the gray levels of
+        //the output image are only for viewing. The image is labeled in
+        //one stripe per hardware thread, with the same labels as
+        //LabelBinarySequentially()
+        Image label_image;
+        const int num_labels = LabelBlockBased(an_image, Connectivity::kEight, &label_image, 0);
+        RenderLabels(label_image, &an_image);
+        CheckObjectFromDatabase(database, label_image, num_labels, &an_image, 0);
+    }
 
 
     if (!WriteImage(output_file, an_image)){
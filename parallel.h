@@ -0,0 +1,49 @@
+// Minimal helpers to split loops across threads.
+// To be used in Computer Vision class.
+//
+// parallel.h
+
+#ifndef COMPUTER_VISION_PARALLEL_H_
+#define COMPUTER_VISION_PARALLEL_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace ComputerVisionProjects {
+
+// Number of threads to use when the caller asks for 0 (automatic).
+inline int DefaultThreadCount() {
+  const unsigned int hardware_threads = std::thread::hardware_concurrency();
+  return hardware_threads == 0 ? 1 : static_cast<int>(hardware_threads);
+}
+
+// Splits [0, count) into at most num_threads contiguous chunks and
+// calls fn(begin, end, chunk_index) for each chunk on its own thread;
+// the calling thread runs the first chunk. Chunk k always covers the
+// same range for a given count and number of chunks, so callers can
+// combine per-chunk results in a deterministic order.
+// num_threads <= 0 means DefaultThreadCount().
+// Returns the number of chunks used.
+template <typename Fn>
+int ParallelFor(size_t count, int num_threads, Fn fn) {
+  if (num_threads <= 0) num_threads = DefaultThreadCount();
+  const size_t num_chunks =
+      std::max<size_t>(1, std::min<size_t>(count, num_threads));
+  const size_t chunk_size = (count + num_chunks - 1) / num_chunks;
+
+  std::vector<std::thread> workers;
+  for (size_t chunk = 1; chunk < num_chunks; ++chunk) {
+    const size_t begin = std::min(count, chunk * chunk_size);
+    const size_t end = std::min(count, begin + chunk_size);
+    workers.emplace_back([=, &fn]() { fn(begin, end, static_cast<int>(chunk)); });
+  }
+  fn(0, std::min(count, chunk_size), 0);
+  for (std::thread &worker : workers) worker.join();
+  return static_cast<int>(num_chunks);
+}
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_PARALLEL_H_
@@ -0,0 +1,201 @@
+//
+// streaming.cc
+// Strip reader and row-by-row labeling for images larger than RAM.
+//
+
+#include "streaming.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace ComputerVisionProjects {
+
+    PgmStripReader::~PgmStripReader() {
+        if (input_ != nullptr) fclose(input_);
+    }
+
+    bool PgmStripReader::Open(const string &filename) {
+        if (input_ != nullptr) fclose(input_);
+        next_row_ = 0;
+        input_ = fopen(filename.c_str(), "rb");
+        if (input_ == nullptr) {
+            cout << "PgmStripReader: Cannot open file" << endl;
+            return false;
+        }
+        if (!ReadPgmHeader(input_, &header_)) {
+            fclose(input_);
+            input_ = nullptr;
+            cout << "PgmStripReader: Expected .pgm file" << endl;
+            return false;
+        }
+        return true;
+    }
+
+    size_t PgmStripReader::ReadStrip(size_t max_rows, Image *strip) {
+        if (strip == nullptr) abort();
+        if (input_ == nullptr || next_row_ >= header_.num_rows) return 0;
+
+        const size_t num_rows = min(max_rows, header_.num_rows - next_row_);
+        const PixelType pixel_type = header_.bytes_per_sample() == 2 ? PixelType::kUInt16 : PixelType::kUInt8;
+        //the last strip may be shorter, it is read into the top rows
+        if (strip->num_rows() < num_rows || strip->num_columns() != header_.num_columns ||
+            strip->pixel_type() != pixel_type) {
+            strip->AllocateSpaceAndSetSize(num_rows, header_.num_columns, pixel_type);
+            strip->SetNumberGrayLevels(header_.max_gray);
+        }
+        if (!ReadPgmPixels(input_, header_, num_rows, strip)) {
+            cout << "PgmStripReader: short file" << endl;
+            next_row_ = header_.num_rows;
+            return 0;
+        }
+        next_row_ += num_rows;
+        return num_rows;
+    }
+
+    StreamingLabeler::StreamingLabeler(size_t num_columns)
+            : num_columns_{num_columns}, row_{0}, bits_((num_columns + 63) / 64),
+              equivalences_(1), moments_(1), first_pixels_(1), live_labels_{0}, peak_labels_{0} {
+    }
+
+    void StreamingLabeler::AddThresholdedRow(const uint8_t *row, int treshold) {
+        AppendThresholdedRuns(row, num_columns_, 0, treshold, &bits_, &current_runs_);
+        LabelCurrentRuns();
+    }
+
+    void StreamingLabeler::LabelCurrentRuns() {
+        const long long i = static_cast<long long>(row_);
+        //8-connectivity: a run touches the runs of the previous row that
+        //overlap it or end right before it or start right after it. Both
+        //lists are sorted, so they are walked together
+        size_t above = 0;
+        for (Run &run: current_runs_) {
+            while (above < previous_runs_.size() && previous_runs_[above].last + 1 < run.first) ++above;
+            uint32_t label = 0;
+            for (size_t k = above; k < previous_runs_.size() && previous_runs_[k].first <= run.last + 1; ++k) {
+                label = label == 0 ? Find(previous_runs_[k].label) : Union(label, previous_runs_[k].label);
+            }
+            if (label == 0) label = NewLabel(uint64_t(row_) * num_columns_ + run.first);
+            //label is a root here; later unions carry the moments along
+            moments_[label].AddRun(i, run.first, run.last);
+            run.label = label;
+            //the last touching run may also touch the next run
+            while (above < previous_runs_.size() && previous_runs_[above].last < run.last) ++above;
+        }
+        previous_runs_.swap(current_runs_);
+        current_runs_.clear();
+        ++row_;
+        peak_labels_ = max(peak_labels_, num_labels());
+        //amortized: the tables are rebuilt once they have doubled
+        if (num_labels() > 2 * live_labels_ + 64) Compact();
+    }
+
+    uint32_t StreamingLabeler::NewLabel(uint64_t first_pixel) {
+        moments_.emplace_back();
+        first_pixels_.push_back(first_pixel);
+        return static_cast<uint32_t>(equivalences_.makeSet());
+    }
+
+    void StreamingLabeler::Compact() {
+        //the roots the last row still reaches
+        vector<bool> live(moments_.size(), false);
+        for (Run &run: previous_runs_) {
+            run.label = Find(run.label);
+            live[run.label] = true;
+        }
+        //roots keep their order, so the smaller label is still the one
+        //with the earlier first pixel
+        vector<uint32_t> new_labels(moments_.size(), 0);
+        uint32_t num_live = 0;
+        for (uint32_t label = 1; label < moments_.size(); ++label) {
+            if (Find(label) != label) continue;
+            if (live[label]) {
+                new_labels[label] = ++num_live;
+                moments_[num_live] = moments_[label];
+                first_pixels_[num_live] = first_pixels_[label];
+            } else {
+                finished_.push_back({first_pixels_[label], moments_[label]});
+            }
+        }
+        moments_.resize(num_live + 1);
+        moments_.shrink_to_fit();
+        first_pixels_.resize(num_live + 1);
+        first_pixels_.shrink_to_fit();
+        equivalences_ = DisjSets(int(num_live + 1));
+        for (Run &run: previous_runs_) run.label = new_labels[run.label];
+        live_labels_ = num_live;
+    }
+
+    uint32_t StreamingLabeler::Union(uint32_t label_a, uint32_t label_b) {
+        const uint32_t root_a = Find(label_a);
+        const uint32_t root_b = Find(label_b);
+        if (root_a == root_b) return root_a;
+        //the smaller label becomes the root, so every root is the
+        //first label of its component in raster order
+        equivalences_.unionSets(root_a, root_b);
+        const uint32_t root = min(root_a, root_b);
+        moments_[root].Add(moments_[root_a + root_b - root]);
+        moments_[root_a + root_b - root] = ComponentMoments();
+        return root;
+    }
+
+    vector<ComponentMoments> StreamingLabeler::Components() {
+        vector<FinishedComponent> all = finished_;
+        for (uint32_t label = 1; label < moments_.size(); ++label) {
+            if (Find(label) == label) all.push_back({first_pixels_[label], moments_[label]});
+        }
+        //finished components were moved out as they ended, not in the
+        //order they started
+        sort(all.begin(), all.end(), [](const FinishedComponent &a, const FinishedComponent &b) {
+            return a.first_pixel < b.first_pixel;
+        });
+        vector<ComponentMoments> components;
+        components.reserve(all.size());
+        for (const FinishedComponent &component: all) components.push_back(component.moments);
+        return components;
+    }
+
+    bool LabelPgmInStrips(const string &filename, int treshold, size_t strip_rows,
+                          vector<ComponentMoments> *components) {
+        if (components == nullptr || strip_rows == 0) abort();
+        PgmStripReader reader;
+        if (!reader.Open(filename)) return false;
+        //the moments of larger images could overflow
+        if (reader.header().num_rows > size_t(kMaxMomentCoordinate) ||
+            reader.header().num_columns > size_t(kMaxMomentCoordinate)) {
+            cout << "LabelPgmInStrips: image larger than " << kMaxMomentCoordinate << " pixels a side" << endl;
+            return false;
+        }
+
+        const size_t num_columns = reader.header().num_columns;
+        StreamingLabeler labeler(num_columns);
+        Image strip;
+        size_t rows_read;
+        while ((rows_read = reader.ReadStrip(strip_rows, &strip)) > 0) {
+            const Image &rows = strip;
+            DispatchPixelType(rows.pixel_type(), [&](auto pixel) {
+                using T = decltype(pixel);
+                for (size_t i = 0; i < rows_read; ++i)
+                    labeler.AddThresholdedRow(rows.Row<T>(i), treshold);
+            });
+        }
+        if (labeler.rows_processed() != reader.header().num_rows) return false;
+        *components = labeler.Components();
+        return true;
+    }
+
+    void LabelThresholded(const Image &an_image, int treshold, vector<ComponentMoments> *components) {
+        if (components == nullptr) abort();
+        StreamingLabeler labeler(an_image.num_columns());
+        DispatchPixelType(an_image.pixel_type(), [&](auto pixel) {
+            using T = decltype(pixel);
+            for (size_t i = 0; i < an_image.num_rows(); ++i)
+                labeler.AddThresholdedRow(an_image.Row<T>(i), treshold);
+        });
+        *components = labeler.Components();
+    }
+}  // namespace ComputerVisionProjects
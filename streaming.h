@@ -0,0 +1,164 @@
+// Streaming, strip-based processing of pgm images that do not fit
+// in memory. To be used in Computer Vision class.
+//
+// streaming.h
+// A PgmStripReader reads an image a few rows at a time and a
+// StreamingLabeler labels thresholded rows as they arrive, keeping
+// only the labels of the previous row, an equivalence table and the
+// moments of each component. Memory use is proportional to one strip
+// plus the number of components, not to the size of the image.
+
+#ifndef COMPUTER_VISION_STREAMING_H_
+#define COMPUTER_VISION_STREAMING_H_
+
+#include "DisjSets.h"
+#include "image.h"
+#include "labeling.h"
+#include "moments.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace ComputerVisionProjects {
+
+// Reads a pgm file from top to bottom in strips of rows.
+// Sample usage:
+//   PgmStripReader reader;
+//   if (!reader.Open("huge.pgm")) ...
+//   Image strip;
+//   while (reader.ReadStrip(256, &strip) > 0) ...
+class PgmStripReader {
+ public:
+  PgmStripReader(): input_{nullptr}, next_row_{0} { }
+  ~PgmStripReader();
+  PgmStripReader(const PgmStripReader &) = delete;
+  PgmStripReader& operator=(const PgmStripReader &) = delete;
+
+  // Opens the file and parses its header.
+  // Returns true if  everyhing is OK, false otherwise.
+  bool Open(const std::string &input_filename);
+
+  const PgmHeader &header() const { return header_; }
+  // Index of the first row the next ReadStrip() returns.
+  size_t next_row() const { return next_row_; }
+
+  // Reads the next (at most) max_rows rows into strip, which is
+  // reallocated only when its size changes. Returns the number of
+  // rows read: 0 at the end of the file or on a short file.
+  size_t ReadStrip(size_t max_rows, Image *strip);
+
+ private:
+  FILE *input_;
+  PgmHeader header_;
+  size_t next_row_;
+};
+
+// Labels a binary image row by row with 8-connectivity and
+// accumulates the moments of every component on the fly.
+// Every row is encoded as runs, which are joined to the touching
+// runs of the previous row; the moments of a run are added in closed
+// form as soon as its label is known, and merged when two labels
+// turn out to be the same component. Thresholding, labeling and the
+// moments all happen while the row is read once.
+// Components are reported in the raster order of their first pixel,
+// which is the order LabelBinarySequentially() numbers them in.
+//
+// A component is finished when no run of the last row belongs to it.
+// Whenever the labels handed out since the last compaction outnumber
+// the ones still in use, the finished components are moved out of
+// the tables and the labels of the last row are renumbered 1..N, so
+// the tables hold a few labels per run of one row, however many
+// provisional labels the image needs overall.
+class StreamingLabeler {
+ public:
+  explicit StreamingLabeler(size_t num_columns);
+
+  // Labels the next row; nonzero pixels are foreground.
+  template <typename T>
+  void AddRow(const T *row) {
+    AppendRuns(row, num_columns_, 0, [](T value) { return value != 0; },
+               &current_runs_);
+    LabelCurrentRuns();
+  }
+  void AddRow(const uint8_t *row) { AddThresholdedRow(row, 1); }
+
+  // Labels the next row of a gray image thresholded on the fly:
+  // pixels >= treshold are foreground, as in ConvertToBinary().
+  template <typename T>
+  void AddThresholdedRow(const T *row, int treshold) {
+    AppendRuns(row, num_columns_, 0,
+               [treshold](T value) { return value >= treshold; },
+               &current_runs_);
+    LabelCurrentRuns();
+  }
+  void AddThresholdedRow(const uint8_t *row, int treshold);
+
+  // Moments of all the components seen so far.
+  std::vector<ComponentMoments> Components();
+
+  size_t rows_processed() const { return row_; }
+  // Provisional labels in the tables now, and at most so far.
+  size_t num_labels() const { return moments_.size() - 1; }
+  size_t peak_labels() const { return peak_labels_; }
+
+ private:
+  // A component no run of the last row belongs to anymore.
+  struct FinishedComponent {
+    uint64_t first_pixel;
+    ComponentMoments moments;
+  };
+
+  // Labels current_runs_ against previous_runs_, adds their moments
+  // and moves on to the next row.
+  void LabelCurrentRuns();
+  // Moves the finished components to finished_ and renumbers the
+  // labels of previous_runs_, keeping their order.
+  void Compact();
+
+  // first_pixel is the raster index of the first pixel of the label.
+  uint32_t NewLabel(uint64_t first_pixel);
+  uint32_t Find(uint32_t label) { return equivalences_.find(label); }
+  // Merges the sets of two labels and their moments; returns the root.
+  uint32_t Union(uint32_t label_a, uint32_t label_b);
+
+  size_t num_columns_;
+  size_t row_;
+  // Runs of the previous and current rows; their row field is unused.
+  std::vector<Run> previous_runs_;
+  std::vector<Run> current_runs_;
+  // Scratch space for thresholding 8-bit rows into bits.
+  std::vector<uint64_t> bits_;
+  // Equivalence table of the provisional labels; entry 0 is unused.
+  DisjSets equivalences_;
+  // Moments per provisional label; only valid for roots.
+  std::vector<ComponentMoments> moments_;
+  // Raster index of the first pixel of every provisional label.
+  std::vector<uint64_t> first_pixels_;
+  std::vector<FinishedComponent> finished_;
+  // Labels in use after the last compaction.
+  size_t live_labels_;
+  size_t peak_labels_;
+};
+
+// Thresholds, labels and measures an image that is already in
+// memory, with a StreamingLabeler fed one row at a time: pixels
+// >= treshold are foreground. The image is read once and no binary
+// or labeled image is written.
+void LabelThresholded(const Image &an_image, int treshold,
+                      std::vector<ComponentMoments> *components);
+
+// Thresholds and labels the pgm file input_filename strip_rows rows
+// at a time and returns the moments of its components; pixels
+// >= treshold are foreground. Only one strip is kept in memory.
+// Images with more than kMaxMomentCoordinate rows or columns are
+// rejected, as their moments could overflow.
+// Returns true if  everyhing is OK, false otherwise.
+bool LabelPgmInStrips(const std::string &input_filename, int treshold,
+                      size_t strip_rows,
+                      std::vector<ComponentMoments> *components);
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_STREAMING_H_
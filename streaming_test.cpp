@@ -0,0 +1,100 @@
+//
+// streaming_test.cpp
+// Checks that a StreamingLabeler finds the same components as
+// LabelBinarySequentially(), and that its tables stay a few rows
+// wide on an image that needs millions of provisional labels.
+//
+
+#include "image.h"
+#include "moments.h"
+#include "streaming.h"
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <vector>
+
+
+using namespace std;
+using namespace ComputerVisionProjects;
+
+namespace {
+    //row i of the three-row pattern: blank, every other pixel, full.
+    //Every alternating row starts num_columns / 2 labels that the full
+    //row below merges into one component
+    void PatternRow(size_t i, vector<uint8_t> *row) {
+        for (size_t j = 0; j < row->size(); ++j) {
+            const int phase = int(i % 3);
+            (*row)[j] = phase == 0 ? 0 : (phase == 1 ? uint8_t(j % 2 == 0 ? 255 : 0) : 255);
+        }
+    }
+
+    bool SameMoments(const ComponentMoments &a, const ComponentMoments &b) {
+        return a.area == b.area && a.sum_i == b.sum_i && a.sum_j == b.sum_j && a.sum_ii == b.sum_ii &&
+               a.sum_ij == b.sum_ij && a.sum_jj == b.sum_jj && a.min_i == b.min_i && a.max_i == b.max_i &&
+               a.min_j == b.min_j && a.max_j == b.max_j;
+    }
+
+    //labels an_image row by row and with LabelBinarySequentially();
+    //returns true if the components and their moments are the same
+    bool MatchesSequential(const Image &an_image) {
+        StreamingLabeler labeler(an_image.num_columns());
+        for (size_t i = 0; i < an_image.num_rows(); ++i) labeler.AddRow(an_image.Row<uint8_t>(i));
+        const vector<ComponentMoments> components = labeler.Components();
+
+        Image label_image;
+        const int num_labels = LabelBinarySequentially(an_image, &label_image);
+        MomentSums sums;
+        AccumulateMoments(label_image, num_labels, &sums);
+        if (components.size() != size_t(num_labels)) return false;
+        for (int label = 1; label <= num_labels; ++label)
+            if (!SameMoments(components[label - 1], sums.Get(label))) return false;
+        return true;
+    }
+}
+
+int
+main(int argc, char **argv){
+
+    int failures = 0;
+
+    //random images of several densities, and the pattern
+    mt19937 generator(3);
+    for (int density: {10, 35, 50, 65, 90}) {
+        Image an_image;
+        an_image.AllocateSpaceAndSetSize(301, 257);
+        an_image.SetNumberGrayLevels(255);
+        for (size_t i = 0; i < an_image.num_rows(); ++i)
+            for (size_t j = 0; j < an_image.num_columns(); ++j)
+                an_image.SetPixel(i, j, int(generator() % 100) < density ? 255 : 0);
+        const bool same = MatchesSequential(an_image);
+        printf("random %d%%: %s\n", density, same ? "ok" : "components differ");
+        if (!same) ++failures;
+    }
+    Image pattern;
+    pattern.AllocateSpaceAndSetSize(300, 300);
+    pattern.SetNumberGrayLevels(255);
+    vector<uint8_t> row(pattern.num_columns());
+    for (size_t i = 0; i < pattern.num_rows(); ++i) {
+        PatternRow(i, &row);
+        for (size_t j = 0; j < row.size(); ++j) pattern.SetPixel(i, j, row[j]);
+    }
+    const bool same = MatchesSequential(pattern);
+    printf("pattern: %s\n", same ? "ok" : "components differ");
+    if (!same) ++failures;
+
+    //6000 x 6000 pattern: 2000 components of 3001 provisional labels
+    //each. The tables must stay within a couple of rows of labels
+    const size_t size = 6000;
+    StreamingLabeler labeler(size);
+    row.assign(size, 0);
+    for (size_t i = 0; i < size; ++i) {
+        PatternRow(i, &row);
+        labeler.AddRow(row.data());
+    }
+    const size_t num_components = labeler.Components().size();
+    printf("pattern %zux%zu: %zu components, at most %zu labels\n", size, size, num_components,
+           labeler.peak_labels());
+    if (num_components != size / 3 || labeler.peak_labels() > 2 * size) ++failures;
+
+    return failures == 0 ? 0 : 1;
+}
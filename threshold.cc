@@ -0,0 +1,239 @@
+//
+// threshold.cc
+// SIMD thresholding kernels. The widest instruction set the CPU
+// supports is picked once, at the first call.
+//
+
+#include "threshold.h"
+#include "parallel.h"
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define COMPUTER_VISION_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace ComputerVisionProjects {
+
+    void BitMask::AllocateSpaceAndSetSize(size_t num_rows, size_t num_columns) {
+        num_rows_ = num_rows;
+        num_columns_ = num_columns;
+        words_per_row_ = (num_columns + 63) / 64;
+        words_.assign(num_rows * words_per_row_, 0);
+    }
+
+    namespace {
+        typedef void (*ThresholdRowKernel)(const uint8_t *, uint8_t *, size_t, uint8_t);
+        typedef void (*ThresholdBitsKernel)(const uint8_t *, uint64_t *, size_t, uint8_t);
+
+        //treshold is already clamped to 1..255 by the callers
+        void ThresholdRowScalar(const uint8_t *in, uint8_t *out, size_t num_pixels, uint8_t treshold) {
+            for (size_t j = 0; j < num_pixels; ++j)
+                out[j] = in[j] < treshold ? 0 : 255;
+        }
+
+        void ThresholdBitsScalar(const uint8_t *in, uint64_t *out, size_t num_pixels, uint8_t treshold) {
+            for (size_t word = 0; word * 64 < num_pixels; ++word) {
+                const size_t first = word * 64;
+                const size_t count = min<size_t>(64, num_pixels - first);
+                uint64_t bits = 0;
+                for (size_t k = 0; k < count; ++k)
+                    bits |= uint64_t(in[first + k] >= treshold) << k;
+                out[word] = bits;
+            }
+        }
+
+#ifdef COMPUTER_VISION_X86
+        //pixel >= treshold exactly when max(pixel, treshold) == pixel,
+        //which avoids the missing unsigned byte compare
+        void ThresholdRowSse2(const uint8_t *in, uint8_t *out, size_t num_pixels, uint8_t treshold) {
+            const __m128i t = _mm_set1_epi8(static_cast<char>(treshold));
+            size_t j = 0;
+            for (; j + 16 <= num_pixels; j += 16) {
+                const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + j));
+                const __m128i mask = _mm_cmpeq_epi8(_mm_max_epu8(v, t), v);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + j), mask);
+            }
+            ThresholdRowScalar(in + j, out + j, num_pixels - j, treshold);
+        }
+
+        void ThresholdBitsSse2(const uint8_t *in, uint64_t *out, size_t num_pixels, uint8_t treshold) {
+            const __m128i t = _mm_set1_epi8(static_cast<char>(treshold));
+            size_t j = 0;
+            for (; j + 64 <= num_pixels; j += 64) {
+                uint64_t bits = 0;
+                for (int k = 0; k < 4; ++k) {
+                    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + j + 16 * k));
+                    const __m128i mask = _mm_cmpeq_epi8(_mm_max_epu8(v, t), v);
+                    bits |= uint64_t(static_cast<uint16_t>(_mm_movemask_epi8(mask))) << (16 * k);
+                }
+                out[j / 64] = bits;
+            }
+            if (j < num_pixels) ThresholdBitsScalar(in + j, out + j / 64, num_pixels - j, treshold);
+        }
+
+        __attribute__((target("avx2")))
+        void ThresholdRowAvx2(const uint8_t *in, uint8_t *out, size_t num_pixels, uint8_t treshold) {
+            const __m256i t = _mm256_set1_epi8(static_cast<char>(treshold));
+            size_t j = 0;
+            for (; j + 32 <= num_pixels; j += 32) {
+                const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + j));
+                const __m256i mask = _mm256_cmpeq_epi8(_mm256_max_epu8(v, t), v);
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + j), mask);
+            }
+            ThresholdRowSse2(in + j, out + j, num_pixels - j, treshold);
+        }
+
+        __attribute__((target("avx2")))
+        void ThresholdBitsAvx2(const uint8_t *in, uint64_t *out, size_t num_pixels, uint8_t treshold) {
+            const __m256i t = _mm256_set1_epi8(static_cast<char>(treshold));
+            size_t j = 0;
+            for (; j + 64 <= num_pixels; j += 64) {
+                const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + j));
+                const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + j + 32));
+                const uint32_t low_bits = static_cast<uint32_t>(
+                        _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(low, t), low)));
+                const uint32_t high_bits = static_cast<uint32_t>(
+                        _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(high, t), high)));
+                out[j / 64] = uint64_t(low_bits) | (uint64_t(high_bits) << 32);
+            }
+            if (j < num_pixels) ThresholdBitsScalar(in + j, out + j / 64, num_pixels - j, treshold);
+        }
+#endif
+
+        struct ThresholdKernels {
+            ThresholdRowKernel row;
+            ThresholdBitsKernel bits;
+            const char *name;
+        };
+
+        ThresholdKernels SelectKernels() {
+#ifdef COMPUTER_VISION_X86
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2"))
+                return {ThresholdRowAvx2, ThresholdBitsAvx2, "avx2"};
+            if (__builtin_cpu_supports("sse2"))
+                return {ThresholdRowSse2, ThresholdBitsSse2, "sse2"};
+#endif
+            return {ThresholdRowScalar, ThresholdBitsScalar, "scalar"};
+        }
+
+        const ThresholdKernels &Kernels() {
+            static const ThresholdKernels kernels = SelectKernels();
+            return kernels;
+        }
+    }
+
+    void ThresholdRow(const uint8_t *in, uint8_t *out, size_t num_pixels, int treshold) {
+        //tresholds outside 1..255 give a constant row
+        if (treshold <= 0 || treshold > 255) {
+            memset(out, treshold <= 0 ? 255 : 0, num_pixels);
+            return;
+        }
+        Kernels().row(in, out, num_pixels, static_cast<uint8_t>(treshold));
+    }
+
+    void ThresholdRowToBits(const uint8_t *in, uint64_t *out, size_t num_pixels, int treshold) {
+        const size_t num_words = (num_pixels + 63) / 64;
+        if (treshold > 255) {
+            memset(out, 0, num_words * sizeof(uint64_t));
+            return;
+        }
+        if (treshold <= 0) {
+            for (size_t word = 0; word < num_words; ++word) {
+                const size_t count = min<size_t>(64, num_pixels - word * 64);
+                out[word] = count == 64 ? ~uint64_t(0) : (uint64_t(1) << count) - 1;
+            }
+            return;
+        }
+        Kernels().bits(in, out, num_pixels, static_cast<uint8_t>(treshold));
+    }
+
+    const char *ThresholdKernelName() {
+        return Kernels().name;
+    }
+
+    void ConvertToBitMask(int treshold, const Image &an_image, BitMask *mask) {
+        if (mask == nullptr || an_image.pixel_type() != PixelType::kUInt8) abort();
+        mask->AllocateSpaceAndSetSize(an_image.num_rows(), an_image.num_columns());
+        for (size_t i = 0; i < an_image.num_rows(); ++i)
+            ThresholdRowToBits(an_image.Row<uint8_t>(i), mask->Row(i), an_image.num_columns(), treshold);
+    }
+    void AdaptiveThreshold(ThresholdMethod method, const AdaptiveThresholdOptions &options,
+                           const Image &input, Image *output) {
+        if (output == nullptr || output == &input ||
+            (method != ThresholdMethod::kBradley && method != ThresholdMethod::kSauvola)) abort();
+        const size_t total_rows = input.num_rows();
+        const size_t total_columns = input.num_columns();
+        output->AllocateSpaceAndSetSize(total_rows, total_columns, input.pixel_type());
+        output->SetNumberGrayLevels(input.num_gray_levels());
+        if (total_rows == 0 || total_columns == 0) return;
+
+        const size_t window = options.window_size > 0 ? options.window_size
+                                                      : max<size_t>(3, min(kMaxDefaultWindowSize, total_columns / 8));
+        const size_t radius = window / 2;
+        const double k = options.k > 0 ? options.k : (method == ThresholdMethod::kBradley ? 0.15 : 0.2);
+        const double dynamic_range = options.dynamic_range;
+
+        //every thread slides the window down its own rows: the column
+        //sums over the window rows are updated by one row in and one row
+        //out, and their prefix sums along the row give the window sums.
+        //The state is a few rows wide whatever the window size
+        ParallelFor(total_rows, options.num_threads, [&](size_t first_row, size_t last_row, int) {
+            vector<uint64_t> column_sums(total_columns, 0);
+            vector<uint64_t> column_squares(total_columns, 0);
+            vector<uint64_t> prefix_sums(total_columns + 1, 0);
+            vector<uint64_t> prefix_squares(total_columns + 1, 0);
+            DispatchPixelType(input.pixel_type(), [&](auto pixel) {
+                using T = decltype(pixel);
+                auto add_row = [&](size_t i, bool add) {
+                    const T *row = input.Row<T>(i);
+                    for (size_t j = 0; j < total_columns; ++j) {
+                        const uint64_t value = static_cast<uint64_t>(row[j]);
+                        if (add) {
+                            column_sums[j] += value;
+                            column_squares[j] += value * value;
+                        } else {
+                            column_sums[j] -= value;
+                            column_squares[j] -= value * value;
+                        }
+                    }
+                };
+                size_t window_top = first_row > radius ? first_row - radius : 0;
+                size_t window_bottom = window_top;
+                for (size_t i = first_row; i < last_row; ++i) {
+                    const size_t top = i > radius ? i - radius : 0;
+                    const size_t bottom = min(total_rows, i + radius + 1);
+                    for (; window_bottom < bottom; ++window_bottom) add_row(window_bottom, true);
+                    for (; window_top < top; ++window_top) add_row(window_top, false);
+                    for (size_t j = 0; j < total_columns; ++j) {
+                        prefix_sums[j + 1] = prefix_sums[j] + column_sums[j];
+                        prefix_squares[j + 1] = prefix_squares[j] + column_squares[j];
+                    }
+
+                    const T *in_row = input.Row<T>(i);
+                    T *out_row = output->Row<T>(i);
+                    for (size_t j = 0; j < total_columns; ++j) {
+                        const size_t window_left = j > radius ? j - radius : 0;
+                        const size_t window_right = min(total_columns, j + radius + 1);
+                        const double count = double((bottom - top) * (window_right - window_left));
+                        const double mean = (prefix_sums[window_right] - prefix_sums[window_left]) / count;
+                        double local_treshold;
+                        if (method == ThresholdMethod::kBradley) {
+                            local_treshold = mean * (1 + k);
+                        } else {
+                            const double squares = (prefix_squares[window_right] - prefix_squares[window_left]) / count;
+                            const double deviation = sqrt(max(0.0, squares - mean * mean));
+                            local_treshold = mean * (1 + k * (1 - deviation / dynamic_range));
+                        }
+                        out_row[j] = double(in_row[j]) > local_treshold ? T(255) : T(0);
+                    }
+                }
+            });
+        });
+    }
+}  // namespace ComputerVisionProjects
@@ -0,0 +1,103 @@
+// Thresholding kernels for gray-scale images.
+// To be used in Computer Vision class.
+//
+// threshold.h
+// Vectorized (AVX2/SSE2 with a scalar fallback, selected at run time)
+// kernels behind ConvertToBinary(), a packed 1-bit-per-pixel mask
+// they can write to instead of a full 8-bit image, and adaptive
+// (local) thresholds computed with a sliding window.
+
+#ifndef COMPUTER_VISION_THRESHOLD_H_
+#define COMPUTER_VISION_THRESHOLD_H_
+
+#include "image.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+namespace ComputerVisionProjects {
+
+// Binary image stored with one bit per pixel. Bit j % 64 of word
+// j / 64 of a row is pixel j (least significant bit first), and
+// every row starts on a new word, so the padding bits are zero.
+class BitMask {
+ public:
+  BitMask(): num_rows_{0}, num_columns_{0}, words_per_row_{0} { }
+
+  // Sets the size of the mask; all pixels are cleared.
+  void AllocateSpaceAndSetSize(size_t num_rows, size_t num_columns);
+
+  size_t num_rows() const { return num_rows_; }
+  size_t num_columns() const { return num_columns_; }
+  size_t words_per_row() const { return words_per_row_; }
+
+  bool Get(size_t i, size_t j) const {
+    if (i >= num_rows_ || j >= num_columns_) abort();
+    return (Row(i)[j / 64] >> (j % 64)) & 1;
+  }
+
+  uint64_t *Row(size_t i) { return words_.data() + i * words_per_row_; }
+  const uint64_t *Row(size_t i) const {
+    return words_.data() + i * words_per_row_;
+  }
+
+ private:
+  size_t num_rows_;
+  size_t num_columns_;
+  size_t words_per_row_;
+  std::vector<uint64_t> words_;
+};
+
+// Sets out[j] to 255 if in[j] >= treshold and to 0 otherwise, for
+// j < num_pixels. in and out may be the same row.
+void ThresholdRow(const uint8_t *in, uint8_t *out, size_t num_pixels,
+                  int treshold);
+
+// Sets bit j of out (see BitMask) if in[j] >= treshold, for
+// j < num_pixels; out holds (num_pixels + 63) / 64 words.
+void ThresholdRowToBits(const uint8_t *in, uint64_t *out, size_t num_pixels,
+                        int treshold);
+
+// Name of the kernel ThresholdRow() dispatches to on this CPU:
+// "avx2", "sse2" or "scalar".
+const char *ThresholdKernelName();
+
+// Thresholds an 8-bit image into a packed mask: pixels >= treshold
+// are set, the same rule ConvertToBinary() uses.
+void ConvertToBitMask(int treshold, const Image &an_image, BitMask *mask);
+
+// Largest window AdaptiveThreshold() picks by itself.
+const size_t kMaxDefaultWindowSize = 127;
+
+// Parameters of AdaptiveThreshold().
+struct AdaptiveThresholdOptions {
+  // Side of the square window around each pixel; 0 picks an eighth
+  // of the image width, at most kMaxDefaultWindowSize. Even sizes
+  // are rounded up to odd ones.
+  size_t window_size = 0;
+  // Sensitivity; 0 picks the method default (0.15 for kBradley,
+  // 0.2 for kSauvola).
+  double k = 0;
+  // Dynamic range of the standard deviation, for kSauvola.
+  double dynamic_range = 128;
+  // The rows are spread over this many threads; 0 uses every core.
+  int num_threads = 0;
+};
+
+// Thresholds every pixel of an 8-bit or 16-bit image against
+// statistics of the window around it, for bright objects on an
+// unevenly lit dark background. method is kBradley (foreground if
+// the pixel exceeds the local mean by a factor 1 + k) or kSauvola
+// (foreground if it exceeds mean * (1 + k * (1 - stddev / R))).
+// output gets the size and pixel type of input and 0/255 pixels;
+// it has to be a different image than input. Each thread slides the
+// window down a contiguous range of rows, so every row is added to the
+// window sums once and removed once, whatever the window size.
+void AdaptiveThreshold(ThresholdMethod method,
+                       const AdaptiveThresholdOptions &options,
+                       const Image &input, Image *output);
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_THRESHOLD_H_